@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+#
+# autotune.py - search the allocator's compile-time knobs
+#
+# Builds one mdriver per setting of the tuning knobs in mm.c (CHUNKSIZE,
+# SPLIT_THRESHOLD, FIT_POLICY, FIT_INDEX), either over the full grid or
+# a random sample of it, runs every build on every trace in parallel,
+# and prints the Pareto frontier of space utilization against
+# throughput overall and for each trace.
+#
+# usage: autotune.py [-j jobs] [-n samples] [-s seed] [-t tracedir] [-S suite]
+#                    [-f trace]... [-k]
+#
+# Throughput is measured with the runs sharing the machine, so compare
+# frontiers from runs made with the same -j; use -j 1 for final numbers.
+#
+
+import argparse
+import concurrent.futures
+import itertools
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+
+KNOBS = {
+    "CHUNKSIZE": [1 << 10, 1 << 11, 1 << 12, 1 << 13, 1 << 14, 1 << 16],
+    "SPLIT_THRESHOLD": [24, 32, 48, 64, 128],
+    "FIT_POLICY": [0, 1],  # BEST_FIT, FIRST_FIT
+    "FIT_INDEX": [0, 1],   # walk the free lists, scan the free-size index
+}
+
+SRCS = ["mdriver.c", "mm.c", "memlib.c", "fsecs.c", "fcyc.c", "clock.c",
+        "ftimer.c", "traceio.c"]
+CC = os.getenv("CC") or "cc"
+CFLAGS = ["-Wall", "-O3", "-g"]
+LIBS = ["-ldl", "-pthread"]  # mdriver loads engines and replays on threads
+BUILDDIR = "autotune.d"
+
+reRow = re.compile(r"^\s*0\s+yes\s+(\d+)%\s+(\d+)\s+([\d.]+)")
+
+
+def readConfig(name, default):
+    """Read a numeric #define from config.h"""
+    with open("config.h") as f:
+        m = re.search(r"#define\s+%s\s+([\d.E+e]+)" % name, f.read())
+    return float(m.group(1)) if m else default
+
+
+UTIL_WEIGHT = readConfig("UTIL_WEIGHT", 0.6)
+AVG_LIBC_THRUPUT = readConfig("AVG_LIBC_THRUPUT", 600e3)
+
+
+def configName(config):
+    return "-".join("%s=%d" % (k, v) for k, v in sorted(config.items()))
+
+
+def build(config):
+    """Compile mdriver with the knobs in config; return its path or None"""
+    outdir = os.path.join(BUILDDIR, configName(config))
+    os.makedirs(outdir, exist_ok=True)
+    exe = os.path.join(outdir, "mdriver")
+    cmd = [CC] + CFLAGS + ["-D%s=%d" % kv for kv in config.items()]
+    cmd += ["-o", exe] + SRCS + LIBS
+    proc = subprocess.run(cmd, capture_output=True, text=True)
+    if proc.returncode != 0:
+        print("build failed:", " ".join(cmd), proc.stderr, file=sys.stderr)
+        return None
+    return exe
+
+
+def runTrace(exe, trace):
+    """Run one build on one trace; return (util, ops, secs) or None"""
+    try:
+        proc = subprocess.run([exe, "-a", "-v", "-f", trace],
+                              capture_output=True, text=True, timeout=600)
+    except subprocess.TimeoutExpired:
+        return None
+    for line in proc.stdout.splitlines():
+        m = reRow.match(line)
+        if m:
+            return int(m.group(1)) / 100.0, int(m.group(2)), float(m.group(3))
+    return None
+
+
+def perfIndex(util, thru):
+    return 100 * (UTIL_WEIGHT * util +
+                  (1 - UTIL_WEIGHT) * min(1.0, thru / AVG_LIBC_THRUPUT))
+
+
+def pareto(points):
+    """Points (util, thru, name) not dominated in both util and thru"""
+    front = []
+    for p in sorted(points, key=lambda p: (-p[0], -p[1])):
+        if not front or p[1] > front[-1][1]:
+            front.append(p)
+    return front
+
+
+def printFront(title, points):
+    print(title)
+    print("  %6s %10s %6s  %s" % ("util", "Kops", "perf", "config"))
+    for util, thru, name in pareto(points):
+        print("  %5.1f%% %10.0f %6.1f  %s" %
+              (util * 100, thru / 1e3, perfIndex(util, thru), name))
+
+
+def suiteTraces(tracedir, suite):
+    """The (trace, weight) pairs of suite in the manifest in tracedir,
+    as mdriver -s reads them"""
+    traces = []
+    current = None
+    with open(os.path.join(tracedir, "suites")) as f:
+        for line in f:
+            line = line.split("#")[0].strip()
+            if line.startswith("["):
+                current = line.strip("[]")
+            elif line and current == suite:
+                fields = line.split()
+                weight = float(fields[1]) if len(fields) > 1 else 1.0
+                traces.append((os.path.join(tracedir, fields[0]), weight))
+    return traces
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Tune the mm.c knobs")
+    parser.add_argument("-j", type=int, default=os.cpu_count(),
+                        help="parallel jobs (default: number of cores)")
+    parser.add_argument("-n", type=int, default=0,
+                        help="random sample of n configs (default: full grid)")
+    parser.add_argument("-s", type=int, default=1, help="random seed")
+    parser.add_argument("-t", default="traces", help="trace directory")
+    parser.add_argument("-f", action="append", help="trace file (repeatable)")
+    parser.add_argument("-S", default="default",
+                        help="suite of traces in <dir>/suites (default: default)")
+    parser.add_argument("-k", action="store_true",
+                        help="keep the builds in " + BUILDDIR)
+    args = parser.parse_args()
+
+    # A trace listed twice counts twice, as it does in mdriver
+    weights = {}
+    for trace, weight in ([(f, 1.0) for f in args.f] if args.f
+                          else suiteTraces(args.t, args.S)):
+        weights[trace] = weights.get(trace, 0.0) + weight
+    traces = list(weights)
+    grid = [dict(zip(KNOBS, values))
+            for values in itertools.product(*KNOBS.values())]
+    if 0 < args.n < len(grid):
+        grid = random.Random(args.s).sample(grid, args.n)
+    print("%d configs x %d traces, %d jobs" % (len(grid), len(traces), args.j))
+
+    with concurrent.futures.ThreadPoolExecutor(args.j) as pool:
+        exes = list(pool.map(build, grid))
+        jobs = {}
+        for config, exe in zip(grid, exes):
+            if exe is None:
+                continue
+            for trace in traces:
+                jobs[(configName(config), trace)] = pool.submit(runTrace,
+                                                                exe, trace)
+        results = {key: job.result() for key, job in jobs.items()}
+
+    # Overall figures are computed as mdriver does, weighing each trace
+    # by its weight in the suite: weighted mean utilization and weighted
+    # ops over weighted time; configs that fail any trace are dropped
+    overall = []
+    pertrace = {trace: [] for trace in traces}
+    for config in grid:
+        name = configName(config)
+        runs = [results.get((name, trace)) for trace in traces]
+        for trace, r in zip(traces, runs):
+            if r is not None:
+                pertrace[trace].append((r[0], r[1] / r[2], name))
+        if all(runs):
+            w = [weights[trace] for trace in traces]
+            util = sum(wt * r[0] for wt, r in zip(w, runs)) / sum(w)
+            thru = (sum(wt * r[1] for wt, r in zip(w, runs)) /
+                    sum(wt * r[2] for wt, r in zip(w, runs)))
+            overall.append((util, thru, name))
+        else:
+            print("%s: failed a trace" % name)
+
+    printFront("\nOverall Pareto frontier:", overall)
+    if overall:
+        best = max(overall, key=lambda p: perfIndex(p[0], p[1]))
+        print("  best perf index: %.1f  %s" % (perfIndex(best[0], best[1]),
+                                               best[2]))
+    for trace in traces:
+        printFront("\n%s:" % trace, pertrace[trace])
+
+    if not args.k:
+        shutil.rmtree(BUILDDIR, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,196 @@
+/*
+ * bench_arena.c - request-scoped allocation through mm_arena versus
+ *                 mm_malloc/mm_free
+ *
+ * Models a server that handles r requests one after another. Each
+ * request makes a random number (up to m) of scratch allocations of
+ * mixed sizes, touches them, and drops all of them when it ends. With
+ * mm_malloc every block is freed (and coalesced) on its own; with the
+ * arena the request ends in a single mm_arena_reset. A background set
+ * of k long-lived blocks is resized between requests in both runs so
+ * that mm's free list is not empty. The checksum of the scratch data
+ * must agree between the two runs.
+ *
+ * usage: bench_arena [-r <requests>] [-m <max allocs per request>]
+ *                    [-k <long-lived blocks>] [-s <seed>]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mm_arena.h"
+
+/* The whole workload is drawn up front so both runs see the same one */
+static size_t num_requests, max_allocs, num_bg;
+static uint32_t *req_count;  /* allocations made by each request */
+static uint32_t *sizes;      /* scratch sizes, all requests in a row */
+static uint32_t *bg_sizes;   /* long-lived block sizes */
+static size_t *bg_victims;   /* long-lived block resized after request i */
+
+typedef struct {
+    double secs;
+    unsigned long sum;
+    size_t heap;
+} result_t;
+
+/* function prototypes */
+static result_t run(int use_arena);
+static void report(const char *name, result_t r, size_t ops);
+static double now(void);
+
+int main(int argc, char **argv)
+{
+    size_t i, total = 0;
+    unsigned seed = 1;
+    int c;
+
+    num_requests = 100000;
+    max_allocs = 64;
+    num_bg = 1000;
+    while ((c = getopt(argc, argv, "r:m:k:s:")) != -1) {
+	switch (c) {
+	case 'r':
+	    num_requests = strtoul(optarg, NULL, 0);
+	    break;
+	case 'm':
+	    max_allocs = strtoul(optarg, NULL, 0);
+	    break;
+	case 'k':
+	    num_bg = strtoul(optarg, NULL, 0);
+	    break;
+	case 's':
+	    seed = strtoul(optarg, NULL, 0);
+	    break;
+	default:
+	    fprintf(stderr, "usage: %s [-r <requests>] [-m <max allocs "
+		    "per request>] [-k <long-lived blocks>] [-s <seed>]\n",
+		    argv[0]);
+	    exit(1);
+	}
+    }
+    if (max_allocs == 0)
+	max_allocs = 1;
+
+    srand(seed);
+    req_count = malloc(num_requests * sizeof(*req_count));
+    bg_victims = malloc(num_requests * sizeof(*bg_victims));
+    for (i = 0; i < num_requests; i++) {
+	req_count[i] = 1 + rand() % max_allocs;
+	bg_victims[i] = num_bg ? rand() % num_bg : 0;
+	total += req_count[i];
+    }
+    /* Mostly small scratch objects with the odd large buffer */
+    sizes = malloc(total * sizeof(*sizes));
+    for (i = 0; i < total; i++)
+	sizes[i] = (rand() % 16 == 0) ? 1024 + rand() % 8192 : 8 + rand() % 248;
+    bg_sizes = malloc((num_bg + num_requests) * sizeof(*bg_sizes));
+    for (i = 0; i < num_bg + num_requests; i++)
+	bg_sizes[i] = 16 + rand() % 2000;
+
+    mem_init();
+    printf("%zu requests, %zu scratch allocations, %zu long-lived blocks\n",
+	   num_requests, total, num_bg);
+    printf("%-12s %10s %10s %12s %20s\n", "allocator", "secs", "Mops/s",
+	   "mm heap", "checksum");
+    report("mm_malloc", run(0), 2 * total);
+    report("mm_arena", run(1), 2 * total);
+    mem_deinit();
+
+    free(req_count);
+    free(bg_victims);
+    free(sizes);
+    free(bg_sizes);
+    return 0;
+}
+
+/*
+ * run - replay the workload through the arena or through mm_malloc
+ */
+static result_t run(int use_arena)
+{
+    void **scratch = malloc(max_allocs * sizeof(void *));
+    void **bg = malloc((num_bg ? num_bg : 1) * sizeof(void *));
+    mm_arena_t *arena = NULL;
+    unsigned long sum = 0;
+    size_t i, j, next = 0;
+    result_t r;
+    double start;
+
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	fprintf(stderr, "mm_init failed\n");
+	exit(1);
+    }
+
+    start = now();
+    for (i = 0; i < num_bg; i++)
+	bg[i] = mm_malloc(bg_sizes[i]);
+    if (use_arena && (arena = mm_arena_create(0)) == NULL) {
+	fprintf(stderr, "mm_arena_create failed\n");
+	exit(1);
+    }
+
+    for (i = 0; i < num_requests; i++) {
+	uint32_t n = req_count[i];
+
+	for (j = 0; j < n; j++) {
+	    uint32_t size = sizes[next + j];
+	    char *p;
+
+	    p = use_arena ? mm_arena_alloc(arena, size) : mm_malloc(size);
+	    if (p == NULL) {
+		fprintf(stderr, "allocation of %u bytes failed\n", size);
+		exit(1);
+	    }
+	    p[0] = (char)j;
+	    p[size - 1] = (char)i;
+	    scratch[j] = p;
+	}
+	for (j = 0; j < n; j++) {
+	    uint32_t size = sizes[next + j];
+
+	    sum += (unsigned char)((char *)scratch[j])[0] +
+		(unsigned char)((char *)scratch[j])[size - 1];
+	    if (!use_arena)
+		mm_free(scratch[j]);
+	}
+	if (use_arena)
+	    mm_arena_reset(arena);
+	next += n;
+
+	if (num_bg > 0) {
+	    mm_free(bg[bg_victims[i]]);
+	    bg[bg_victims[i]] = mm_malloc(bg_sizes[num_bg + i]);
+	}
+    }
+
+    if (use_arena)
+	mm_arena_destroy(arena);
+    for (i = 0; i < num_bg; i++)
+	mm_free(bg[i]);
+    r.secs = now() - start;
+    r.sum = sum;
+    r.heap = mem_heapsize();
+
+    free(scratch);
+    free(bg);
+    return r;
+}
+
+static void report(const char *name, result_t r, size_t ops)
+{
+    printf("%-12s %10.4f %10.2f %12zu %20lu\n", name, r.secs,
+	   ops / r.secs / 1e6, r.heap, r.sum);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
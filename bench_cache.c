@@ -0,0 +1,96 @@
+/*
+ * bench_cache.c - Hoard's cache-thrash and cache-scratch tests
+ *
+ * The threads split i iterations; in each, a thread allocates an
+ * object of z bytes, writes every byte of it w times and frees it. An
+ * allocator that hands small objects on one cache line to different
+ * threads makes them fight over the line (active false sharing). With
+ * -p (cache-scratch), the main thread first allocates one object per
+ * thread, back to back, and each thread starts by freeing its object,
+ * so an allocator that reuses the freed memory for that thread makes
+ * the sharing happen even though no thread asked for it (passive
+ * false sharing). The operation count is the number of writes.
+ *
+ * usage: bench_cache [common options] [-p] [-i <iterations>]
+ *                    [-w <writes per byte>] [-z <object size>]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_mt.h"
+
+static int passive;
+static long iterations = 100000;
+static int repetitions = 50;
+static size_t object_size = 8;
+
+typedef struct {
+    long iterations;   /* this thread's share */
+    char *handed;      /* object from the main thread (-p only) */
+} share_t;
+
+static void *worker(void *arg)
+{
+    share_t *s = arg;
+    long i;
+    int r;
+    size_t j;
+
+    if (s->handed != NULL)
+	bench_free(s->handed);
+    for (i = 0; i < s->iterations; i++) {
+	volatile char *p = bench_malloc(object_size);
+
+	if (p == NULL) {
+	    fprintf(stderr, "cache: allocation failed\n");
+	    exit(1);
+	}
+	for (r = 0; r < repetitions; r++)
+	    for (j = 0; j < object_size; j++)
+		p[j] = p[j] + 1;
+	bench_free((void *)p);
+    }
+    return NULL;
+}
+
+static double run(int nthreads)
+{
+    share_t *shares = malloc(nthreads * sizeof(share_t));
+    int t;
+
+    for (t = 0; t < nthreads; t++) {
+	shares[t].iterations = iterations / nthreads;
+	shares[t].handed = passive ? bench_malloc(object_size) : NULL;
+    }
+    bench_spawn(nthreads, worker, shares, sizeof(share_t));
+    free(shares);
+    return (double)(iterations / nthreads) * nthreads * repetitions * object_size;
+}
+
+static int option(int c, const char *arg)
+{
+    switch (c) {
+    case 'p':
+	passive = 1;
+	bench.name = "cache-scratch";
+	return 1;
+    case 'i':
+	iterations = strtol(arg, NULL, 0);
+	return 1;
+    case 'w':
+	repetitions = atoi(arg);
+	return 1;
+    case 'z':
+	object_size = strtoul(arg, NULL, 0);
+	if (object_size == 0)
+	    object_size = 1;
+	return 1;
+    }
+    return 0;
+}
+
+bench_mt_t bench = {
+    "cache-thrash", "pi:w:z:",
+    "[-p] [-i <iterations>] [-w <writes per byte>] [-z <object size>]",
+    option, run
+};
@@ -0,0 +1,128 @@
+/*
+ * bench_larson.c - Larson and Krishnan's server simulation
+ *
+ * Each thread owns an array of n live blocks and, r times, frees a
+ * random one and allocates a new one of random size between a and b
+ * bytes. It then hands the array to a fresh thread and exits, for g
+ * generations, so that most blocks are freed by a thread other than
+ * the one that allocated them, as in a server whose worker threads
+ * come and go. The initial blocks are allocated by the main thread.
+ *
+ * usage: bench_larson [common options] [-n <blocks per thread>]
+ *                     [-r <rounds>] [-g <generations>] [-a <min size>]
+ *                     [-b <max size>]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "bench_mt.h"
+
+static size_t num_blocks = 1000;
+static long rounds = 20000;
+static int generations = 10;
+static size_t min_size = 10, max_size = 400;
+
+/* One thread's blocks, passed down from generation to generation */
+typedef struct {
+    void **blocks;
+    unsigned seed;
+} lineage_t;
+
+static size_t random_size(unsigned *seed)
+{
+    return min_size + bench_rand(seed) % (max_size - min_size + 1);
+}
+
+/*
+ * worker - one generation: r random replacements, then exit
+ */
+static void *worker(void *arg)
+{
+    lineage_t *l = arg;
+    long i;
+
+    for (i = 0; i < rounds; i++) {
+	size_t victim = bench_rand(&l->seed) % num_blocks;
+	size_t size = random_size(&l->seed);
+	char *p;
+
+	bench_free(l->blocks[victim]);
+	if ((p = bench_malloc(size)) == NULL) {
+	    fprintf(stderr, "larson: allocation of %zu bytes failed\n", size);
+	    exit(1);
+	}
+	p[0] = p[size - 1] = (char)i;
+	l->blocks[victim] = p;
+    }
+    return NULL;
+}
+
+/*
+ * lineage - run the generations of one thread one after another
+ */
+static void *lineage(void *arg)
+{
+    int g;
+
+    for (g = 0; g < generations; g++)
+	bench_spawn(1, worker, arg, 0);
+    return NULL;
+}
+
+static double run(int nthreads)
+{
+    lineage_t *ls = malloc(nthreads * sizeof(lineage_t));
+    size_t i;
+    int t;
+
+    for (t = 0; t < nthreads; t++) {
+	ls[t].blocks = malloc(num_blocks * sizeof(void *));
+	ls[t].seed = bench_seed * 2654435761u + t + 1;
+	for (i = 0; i < num_blocks; i++)
+	    ls[t].blocks[i] = bench_malloc(random_size(&ls[t].seed));
+    }
+    bench_spawn(nthreads, lineage, ls, sizeof(lineage_t));
+    for (t = 0; t < nthreads; t++) {
+	for (i = 0; i < num_blocks; i++)
+	    bench_free(ls[t].blocks[i]);
+	free(ls[t].blocks);
+    }
+    free(ls);
+    return (double)nthreads * generations * rounds * 2;
+}
+
+static int option(int c, const char *arg)
+{
+    switch (c) {
+    case 'n':
+	num_blocks = strtoul(arg, NULL, 0);
+	if (num_blocks == 0)
+	    num_blocks = 1;
+	return 1;
+    case 'r':
+	rounds = strtol(arg, NULL, 0);
+	return 1;
+    case 'g':
+	generations = atoi(arg);
+	return 1;
+    case 'a':
+	min_size = strtoul(arg, NULL, 0);
+	if (min_size == 0)
+	    min_size = 1;
+	return 1;
+    case 'b':
+	max_size = strtoul(arg, NULL, 0);
+	if (max_size < min_size)
+	    max_size = min_size;
+	return 1;
+    }
+    return 0;
+}
+
+bench_mt_t bench = {
+    "larson", "n:r:g:a:b:",
+    "[-n <blocks per thread>] [-r <rounds>] [-g <generations>] "
+    "[-a <min size>] [-b <max size>]",
+    option, run
+};
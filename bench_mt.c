@@ -0,0 +1,136 @@
+/*
+ * bench_mt.c - thread-count sweep for the multi-threaded benchmarks
+ *
+ * mm.c is not thread-safe, so every mm call takes one global lock, as
+ * in libmm.so; -l runs the same benchmark on the C library's malloc
+ * for comparison. The mm heap is reset before every run.
+ *
+ * usage: bench_<name> [-t <max threads>] [-l] [-s <seed>] [options]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "bench_mt.h"
+
+unsigned bench_seed = 1;
+
+/* private variables */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int use_libc;
+
+/* function prototypes */
+static void usage(const char *prog);
+static double now(void);
+
+void *bench_malloc(size_t size)
+{
+    void *p;
+
+    if (use_libc)
+	return malloc(size);
+    pthread_mutex_lock(&lock);
+    p = mm_malloc((uint32_t)size);
+    pthread_mutex_unlock(&lock);
+    return p;
+}
+
+void bench_free(void *ptr)
+{
+    if (use_libc) {
+	free(ptr);
+	return;
+    }
+    pthread_mutex_lock(&lock);
+    mm_free(ptr);
+    pthread_mutex_unlock(&lock);
+}
+
+void bench_spawn(int nthreads, void *(*fn)(void *), void *arg, size_t argsize)
+{
+    pthread_t *tids = malloc(nthreads * sizeof(pthread_t));
+    int i;
+
+    if (tids == NULL) {
+	fprintf(stderr, "malloc failed in bench_spawn\n");
+	exit(1);
+    }
+    for (i = 0; i < nthreads; i++)
+	if (pthread_create(&tids[i], NULL, fn, (char *)arg + i * argsize)) {
+	    fprintf(stderr, "pthread_create failed\n");
+	    exit(1);
+	}
+    for (i = 0; i < nthreads; i++)
+	pthread_join(tids[i], NULL);
+    free(tids);
+}
+
+int main(int argc, char **argv)
+{
+    char optstring[64];
+    int max_threads = 4;
+    int c, k;
+
+    snprintf(optstring, sizeof(optstring), "t:ls:%s", bench.opts);
+    while ((c = getopt(argc, argv, optstring)) != -1) {
+	switch (c) {
+	case 't':
+	    max_threads = atoi(optarg);
+	    break;
+	case 'l':
+	    use_libc = 1;
+	    break;
+	case 's':
+	    bench_seed = strtoul(optarg, NULL, 0);
+	    break;
+	default:
+	    if (c == '?' || !bench.option(c, optarg))
+		usage(argv[0]);
+	}
+    }
+    if (max_threads < 1)
+	max_threads = 1;
+
+    mem_init();
+    printf("%s on %s\n", bench.name, use_libc ? "libc" : "mm (global lock)");
+    printf("%8s %10s %12s %12s\n", "threads", "secs", "Mops/s", "mm heap");
+    for (k = 1; k <= max_threads; k++) {
+	double start, secs, ops;
+
+	mem_reset_brk();
+	if (mm_init() < 0) {
+	    fprintf(stderr, "mm_init failed\n");
+	    exit(1);
+	}
+	start = now();
+	ops = bench.run(k);
+	secs = now() - start;
+	printf("%8d %10.4f %12.3f %12zu\n", k, secs, ops / secs / 1e6,
+	       use_libc ? 0 : mem_heapsize());
+    }
+    mem_deinit();
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-t <max threads>] [-l] [-s <seed>] %s\n",
+	    prog, bench.usage);
+    fprintf(stderr, "\t-t <n>  Run with 1..<n> threads (default 4).\n");
+    fprintf(stderr, "\t-l      Use the C library's malloc instead of mm.\n");
+    fprintf(stderr, "\t-s <n>  Seed for the random choices.\n");
+    exit(1);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
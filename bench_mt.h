@@ -0,0 +1,51 @@
+/*
+ * bench_mt.h - common driver for the multi-threaded benchmarks
+ *
+ * Each bench_*.c defines one benchmark as a bench_mt_t named bench and
+ * is linked with bench_mt.o, which provides main(): it parses the
+ * common options, runs the benchmark with 1..n threads and prints the
+ * throughput of each run. The benchmark allocates through
+ * bench_malloc() and bench_free(), which go to mm under one global
+ * lock, or straight to the C library with -l.
+ */
+#ifndef __BENCH_MT_H_
+#define __BENCH_MT_H_
+
+#include <stddef.h>
+
+typedef struct {
+    const char *name;
+    const char *opts;    /* getopt letters of its own options */
+    const char *usage;   /* their usage text */
+
+    /* Handle one of its options; return 0 if c is not one */
+    int (*option)(int c, const char *arg);
+
+    /* Run with nthreads threads; return the number of operations done */
+    double (*run)(int nthreads);
+} bench_mt_t;
+
+extern bench_mt_t bench;
+
+/* Seed given with -s, for the benchmark's per-thread generators */
+extern unsigned bench_seed;
+
+/* The allocator under test; safe to call from any thread */
+void *bench_malloc(size_t size);
+void bench_free(void *ptr);
+
+/* Start nthreads threads running fn(arg + i * argsize) and wait for them */
+void bench_spawn(int nthreads, void *(*fn)(void *), void *arg, size_t argsize);
+
+/* Next value of a per-thread xorshift generator */
+static inline unsigned bench_rand(unsigned *state)
+{
+    unsigned x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+#endif /* __BENCH_MT_H_ */
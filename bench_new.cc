@@ -0,0 +1,99 @@
+/*
+ * bench_new.cc - std::map / std::unordered_map churn with the global
+ *                operator new replaced by mm_new.cc
+ *
+ * The same workload as bench_pmr, on containers with the default
+ * std::allocator, in a program linked with mm_new.o so that every node
+ * comes from the mm heap. Compare its times with the std::allocator
+ * rows of bench_pmr. The heap is checked after each run, and the
+ * program fails if the mm heap was never created, which means operator
+ * new was not replaced.
+ *
+ * usage: bench_new [-n <live keys>] [-m <churn ops>] [-s <seed>]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "mm_allocator.h"
+
+namespace {
+
+/* The keys inserted and erased, shared by every run */
+std::vector<int> keys;
+
+template <class Map>
+void run(const char *container, size_t n, size_t ops)
+{
+    auto start = std::chrono::steady_clock::now();
+    {
+        Map map;
+
+        for (size_t i = 0; i < n; i++)
+            map.emplace(keys[i], (int)i);
+        for (size_t i = n; i < keys.size(); i++) {
+            map.erase(keys[i - n]);
+            map.emplace(keys[i], (int)i);
+        }
+    }
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+
+    if (mm_checkheap(MM_CHECK_LISTS) < 0) {
+        fprintf(stderr, "%s: mm_checkheap failed\n", container);
+        exit(1);
+    }
+    printf("%-15s %10.4f %10.2f %12zu\n", container, secs.count(),
+           ops / secs.count() / 1e6, mem_heapsize());
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t n = 100000, m = 1000000;
+    unsigned seed = 1;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:m:s:")) != -1) {
+        switch (c) {
+        case 'n':
+            n = strtoul(optarg, nullptr, 0);
+            break;
+        case 'm':
+            m = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            seed = strtoul(optarg, nullptr, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n <live keys>] [-m <churn ops>] "
+                    "[-s <seed>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(seed);
+    keys.resize(n + m);
+    for (auto &k : keys)
+        k = (int)rng();
+
+    /* keys came from operator new, so the heap exists by now */
+    if (mem_heapsize() == 0) {
+        fprintf(stderr, "operator new did not use the mm heap\n");
+        return 1;
+    }
+
+    size_t ops = n + 2 * m;
+
+    printf("%-15s %10s %10s %12s\n", "container", "secs", "Mops/s",
+           "mm heap");
+    run<std::map<int, int>>("map", n, ops);
+    run<std::unordered_map<int, int>>("unordered_map", n, ops);
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * bench_pmr.cc - std::map / std::unordered_map churn on the mm heap
+ *                versus the default allocator
+ *
+ * Each run fills a container with n random keys, then performs m
+ * erase/insert pairs so that the live set stays at n while nodes are
+ * continuously freed and reallocated. The mm runs start from a fresh
+ * heap and also report its final size.
+ *
+ * usage: bench_pmr [-n <live keys>] [-m <churn ops>] [-s <seed>]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory_resource>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "mm_allocator.h"
+
+namespace {
+
+struct result {
+    double secs;
+    size_t heap; /* mm heap size afterwards, or 0 for the default allocator */
+};
+
+/* The keys inserted and erased, shared by every run */
+std::vector<int> keys;
+
+template <class Map>
+double churn(Map &map, size_t n)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < n; i++)
+        map.emplace(keys[i], (int)i);
+    for (size_t i = n; i < keys.size(); i++) {
+        map.erase(keys[i - n]);
+        map.emplace(keys[i], (int)i);
+    }
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+    return secs.count();
+}
+
+/* Run one configuration; mm-backed maps get a fresh heap first */
+template <class Map, class... Args>
+result run(bool on_mm, size_t n, Args &&...args)
+{
+    result r;
+
+    if (on_mm) {
+        mem_reset_brk();
+        if (mm_init() < 0) {
+            fprintf(stderr, "mm_init failed\n");
+            exit(1);
+        }
+    }
+    {
+        Map map(std::forward<Args>(args)...);
+        r.secs = churn(map, n);
+    }
+    r.heap = on_mm ? mem_heapsize() : 0;
+    return r;
+}
+
+void report(const char *container, const char *alloc, result r, size_t ops)
+{
+    printf("%-15s %-22s %10.4f %10.2f", container, alloc, r.secs,
+           ops / r.secs / 1e6);
+    if (r.heap)
+        printf(" %12zu\n", r.heap);
+    else
+        printf(" %12s\n", "-");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t n = 100000, m = 1000000;
+    unsigned seed = 1;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:m:s:")) != -1) {
+        switch (c) {
+        case 'n':
+            n = strtoul(optarg, nullptr, 0);
+            break;
+        case 'm':
+            m = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            seed = strtoul(optarg, nullptr, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n <live keys>] [-m <churn ops>] "
+                    "[-s <seed>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(seed);
+    keys.resize(n + m);
+    for (auto &k : keys)
+        k = (int)rng();
+
+    mem_init();
+    size_t ops = n + 2 * m;
+
+    typedef std::less<int> lt;
+    typedef std::hash<int> hash;
+    typedef std::equal_to<int> eq;
+    typedef std::pair<const int, int> node;
+
+    printf("%-15s %-22s %10s %10s %12s\n", "container", "allocator", "secs",
+           "Mops/s", "mm heap");
+    report("map", "std::allocator", run<std::map<int, int>>(false, n), ops);
+    report("map", "mm_allocator",
+           run<std::map<int, int, lt, mm_allocator<node>>>(true, n), ops);
+    report("map", "pmr/new_delete",
+           run<std::pmr::map<int, int>>(false, n,
+                                         std::pmr::new_delete_resource()), ops);
+    report("map", "pmr/mm_memory_resource",
+           run<std::pmr::map<int, int>>(true, n, mm_resource()), ops);
+
+    report("unordered_map", "std::allocator",
+           run<std::unordered_map<int, int>>(false, n), ops);
+    report("unordered_map", "mm_allocator",
+           run<std::unordered_map<int, int, hash, eq, mm_allocator<node>>>(true, n),
+           ops);
+    report("unordered_map", "pmr/new_delete",
+           run<std::pmr::unordered_map<int, int>>(false, n,
+                                                   std::pmr::new_delete_resource()),
+           ops);
+    report("unordered_map", "pmr/mm_memory_resource",
+           run<std::pmr::unordered_map<int, int>>(true, n, mm_resource()), ops);
+
+    mem_deinit();
+    return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * bench_pool.cc - node churn through mm_pool<T> versus mm_malloc
+ *
+ * Keeps n nodes live and then m times replaces a random one, the
+ * allocation pattern of a linked structure whose nodes are inserted and
+ * removed at random. Alongside the nodes, k variable-sized blocks are
+ * churned through mm_malloc in both runs, as the rest of a program
+ * would, so that mm's free list is not made up of node-sized holes
+ * only. Every node is written when it is allocated, so a broken pool
+ * shows up as a checksum mismatch between the two runs.
+ *
+ * usage: bench_pool [-n <live nodes>] [-m <churn ops>] [-k <other blocks>]
+ *                   [-s <seed>]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+#include "mm_pool.h"
+
+extern "C" {
+#include "memlib.h"
+}
+
+namespace {
+
+/* A typical tree/list node: three links and some payload */
+struct node {
+    node *left, *right, *parent;
+    long key;
+    long value;
+};
+
+struct result {
+    double secs;
+    unsigned long sum;
+    size_t heap;
+};
+
+/* Per churn step: which node to replace, and which other block to resize */
+std::vector<size_t> victims;
+std::vector<size_t> others;
+std::vector<uint32_t> other_sizes;
+
+struct with_malloc {
+    node *get() { return static_cast<node *>(mm_malloc(sizeof(node))); }
+    void put(node *p) { mm_free(p); }
+};
+
+struct with_pool {
+    mm_pool<node> pool;
+    node *get() { return pool.allocate(); }
+    void put(node *p) { pool.deallocate(p); }
+};
+
+template <class Alloc>
+result run(size_t n, size_t k)
+{
+    std::vector<node *> live(n);
+    std::vector<void *> other(k);
+    unsigned long sum = 0;
+    result r;
+
+    mem_reset_brk();
+    if (mm_init() < 0) {
+        fprintf(stderr, "mm_init failed\n");
+        exit(1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        Alloc a;
+
+        for (size_t i = 0; i < n; i++) {
+            live[i] = a.get();
+            live[i]->key = (long)i;
+            if (i < k)
+                other[i] = mm_malloc(other_sizes[i]);
+        }
+        for (size_t i = 0; i < victims.size(); i++) {
+            node *&v = live[victims[i]];
+
+            sum += (unsigned long)v->key;
+            a.put(v);
+            v = a.get();
+            v->key = (long)i;
+            if (k > 0) {
+                mm_free(other[others[i]]);
+                other[others[i]] = mm_malloc(other_sizes[i]);
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            sum += (unsigned long)live[i]->key;
+            a.put(live[i]);
+        }
+        for (size_t i = 0; i < k; i++)
+            mm_free(other[i]);
+        r.heap = mem_heapsize();
+    }
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+
+    r.secs = secs.count();
+    r.sum = sum;
+    return r;
+}
+
+void report(const char *name, result r, size_t ops)
+{
+    printf("%-12s %10.4f %10.2f %12zu %20lu\n", name, r.secs,
+           ops / r.secs / 1e6, r.heap, r.sum);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t n = 20000, m = 500000, k = 1000;
+    unsigned seed = 1;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:m:k:s:")) != -1) {
+        switch (c) {
+        case 'n':
+            n = strtoul(optarg, nullptr, 0);
+            break;
+        case 'm':
+            m = strtoul(optarg, nullptr, 0);
+            break;
+        case 'k':
+            k = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            seed = strtoul(optarg, nullptr, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n <live nodes>] [-m <churn ops>] "
+                    "[-k <other blocks>] [-s <seed>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (n == 0)
+        n = 1;
+    if (k > n)
+        k = n;
+
+    std::mt19937 rng(seed);
+    victims.resize(m);
+    others.resize(m);
+    other_sizes.resize(m > n ? m : n);
+    for (size_t i = 0; i < m; i++) {
+        victims[i] = rng() % n;
+        others[i] = k ? rng() % k : 0;
+    }
+    for (auto &s : other_sizes)
+        s = 16 + rng() % 1000;
+
+    mem_init();
+    printf("mm_pool<node>: %zu-byte slots, %zu per %zu-byte slab\n",
+           mm_pool<node>::slot_size, mm_pool<node>::slots_per_slab,
+           mm_pool<node>::slab_size);
+    printf("%-12s %10s %10s %12s %20s\n", "allocator", "secs", "Mops/s",
+           "mm heap", "checksum");
+
+    size_t ops = 2 * (n + m) + (k ? 2 * (k + m) : 0);
+    report("mm_malloc", run<with_malloc>(n, k), ops);
+    report("mm_pool", run<with_pool>(n, k), ops);
+
+    mem_deinit();
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * bench_threadtest.c - Hoard's threadtest
+ *
+ * The threads split a fixed amount of work: i times, each allocates
+ * its share of n objects of s bytes and then frees them all. Every
+ * block is freed by the thread that allocated it, so this measures
+ * how allocation scales when threads do not share memory at all.
+ *
+ * usage: bench_threadtest [common options] [-i <iterations>]
+ *                         [-n <objects>] [-z <object size>]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_mt.h"
+
+static int iterations = 50;
+static long num_objects = 100000;
+static size_t object_size = 8;
+
+typedef struct {
+    long count;    /* this thread's share of the objects */
+} share_t;
+
+static void *worker(void *arg)
+{
+    share_t *s = arg;
+    char **objs = malloc(s->count * sizeof(char *));
+    long j;
+    int i;
+
+    for (i = 0; i < iterations; i++) {
+	for (j = 0; j < s->count; j++) {
+	    if ((objs[j] = bench_malloc(object_size)) == NULL) {
+		fprintf(stderr, "threadtest: allocation failed\n");
+		exit(1);
+	    }
+	    objs[j][0] = (char)j;
+	}
+	for (j = 0; j < s->count; j++)
+	    bench_free(objs[j]);
+    }
+    free(objs);
+    return NULL;
+}
+
+static double run(int nthreads)
+{
+    share_t *shares = malloc(nthreads * sizeof(share_t));
+    int t;
+
+    for (t = 0; t < nthreads; t++)
+	shares[t].count = num_objects / nthreads;
+    bench_spawn(nthreads, worker, shares, sizeof(share_t));
+    free(shares);
+    return (double)(num_objects / nthreads) * nthreads * iterations * 2;
+}
+
+static int option(int c, const char *arg)
+{
+    switch (c) {
+    case 'i':
+	iterations = atoi(arg);
+	return 1;
+    case 'n':
+	num_objects = strtol(arg, NULL, 0);
+	return 1;
+    case 'z':
+	object_size = strtoul(arg, NULL, 0);
+	if (object_size == 0)
+	    object_size = 1;
+	return 1;
+    }
+    return 0;
+}
+
+bench_mt_t bench = {
+    "threadtest", "i:n:z:",
+    "[-i <iterations>] [-n <objects>] [-z <object size>]",
+    option, run
+};
@@ -0,0 +1,138 @@
+/*
+ * bench_xmalloc.c - producer/consumer test after xmalloc-test
+ *
+ * Each thread allocates batches of b blocks of random size up to z
+ * bytes and appends each batch to a shared queue. Once the queue holds
+ * one batch per thread, it takes the oldest one, usually another
+ * thread's, and frees it, so with more than one thread most blocks
+ * are freed by a thread that did not allocate them. Each thread makes
+ * m batches.
+ *
+ * usage: bench_xmalloc [common options] [-m <batches per thread>]
+ *                      [-b <batch size>] [-z <max size>]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "bench_mt.h"
+
+static long num_batches = 20000;
+static int batch_size = 64;
+static size_t max_size = 120;
+
+/* A batch of blocks; itself allocated with bench_malloc */
+typedef struct batch {
+    struct batch *next;
+    void *blocks[];
+} batch_t;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static batch_t *head, *tail;
+static int queued;
+
+typedef struct {
+    unsigned seed;
+    int nthreads;
+} producer_t;
+
+static void free_batch(batch_t *b)
+{
+    int i;
+
+    for (i = 0; i < batch_size; i++)
+	bench_free(b->blocks[i]);
+    bench_free(b);
+}
+
+static void *worker(void *arg)
+{
+    producer_t *pr = arg;
+    long n;
+    int i;
+
+    for (n = 0; n < num_batches; n++) {
+	batch_t *b = bench_malloc(sizeof(batch_t) + batch_size * sizeof(void *));
+
+	if (b == NULL) {
+	    fprintf(stderr, "xmalloc: allocation failed\n");
+	    exit(1);
+	}
+	for (i = 0; i < batch_size; i++) {
+	    size_t size = 1 + bench_rand(&pr->seed) % max_size;
+
+	    if ((b->blocks[i] = bench_malloc(size)) == NULL) {
+		fprintf(stderr, "xmalloc: allocation failed\n");
+		exit(1);
+	    }
+	    ((char *)b->blocks[i])[0] = (char)i;
+	}
+
+	pthread_mutex_lock(&queue_lock);
+	b->next = NULL;
+	if (tail != NULL)
+	    tail->next = b;
+	else
+	    head = b;
+	tail = b;
+	b = NULL;
+	if (++queued >= pr->nthreads) {
+	    b = head;
+	    if ((head = b->next) == NULL)
+		tail = NULL;
+	    queued--;
+	}
+	pthread_mutex_unlock(&queue_lock);
+	if (b != NULL)
+	    free_batch(b);
+    }
+    return NULL;
+}
+
+static double run(int nthreads)
+{
+    producer_t *prs = malloc(nthreads * sizeof(producer_t));
+    int t;
+
+    for (t = 0; t < nthreads; t++) {
+	prs[t].seed = bench_seed * 2654435761u + t + 1;
+	prs[t].nthreads = nthreads;
+    }
+    bench_spawn(nthreads, worker, prs, sizeof(producer_t));
+    while (head != NULL) {
+	batch_t *b = head;
+
+	head = b->next;
+	free_batch(b);
+    }
+    tail = NULL;
+    queued = 0;
+    free(prs);
+    return (double)nthreads * num_batches * (batch_size + 1) * 2;
+}
+
+static int option(int c, const char *arg)
+{
+    switch (c) {
+    case 'm':
+	num_batches = strtol(arg, NULL, 0);
+	return 1;
+    case 'b':
+	batch_size = atoi(arg);
+	if (batch_size < 1)
+	    batch_size = 1;
+	return 1;
+    case 'z':
+	max_size = strtoul(arg, NULL, 0);
+	if (max_size == 0)
+	    max_size = 1;
+	return 1;
+    }
+    return 0;
+}
+
+bench_mt_t bench = {
+    "xmalloc", "m:b:z:",
+    "[-m <batches per thread>] [-b <batch size>] [-z <max size>]",
+    option, run
+};
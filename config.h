@@ -15,22 +15,14 @@
 #define TRACEDIR "./traces/"
 
 /*
- * This is the list of default tracefiles in TRACEDIR that the driver
- * will use for testing. Modify this if you want to add or delete
- * traces from the driver's test suite. For example, if you don't want
- * your students to implement realloc, you can delete the last two
- * traces.
+ * The traces the driver uses are listed by suite, each trace with a
+ * weight, in the manifest SUITEFILE in the trace directory. The driver
+ * runs DEFAULT_SUITE unless it is given -s <suite> or -f <file>. Edit
+ * the manifest if you want to add or delete traces from the driver's
+ * test suite.
  */
-#define DEFAULT_TRACEFILES \
-  "binary-bal.rep",\
-  "binary2-bal.rep",\
-  "cccp-bal.rep",\
-  "coalescing-bal.rep",\
-  "cp-decl-bal.rep",\
-  "random-bal.rep",\
-  "random2-bal.rep",\
-  "realloc-bal.rep",\
-  "realloc2-bal.rep"
+#define SUITEFILE "suites"
+#define DEFAULT_SUITE "default"
 
 /*
  * This constant gives the estimated performance of the libc malloc
@@ -58,7 +50,9 @@
 /* 
  * Maximum heap size in bytes 
  */
+#ifndef MAX_HEAP
 #define MAX_HEAP (400*(1<<20))  /* 400 MB */
+#endif
 
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
@@ -0,0 +1,39 @@
+/*
+ * engine_libc.c - mdriver engine for the system allocator
+ *
+ * The C library gives no way to reset its heap or to read its peak
+ * footprint, so init does nothing and the engine reports throughput
+ * only.
+ */
+#include <stdlib.h>
+
+#include "mm_engine.h"
+
+static int engine_init(void)
+{
+    return 0;
+}
+
+static void *engine_malloc(uint32_t size)
+{
+    return malloc(size);
+}
+
+static void *engine_realloc(void *ptr, uint32_t size)
+{
+    return realloc(ptr, size);
+}
+
+MM_ENGINE_EXPORT const mm_engine_t mm_engine = {
+    MM_ENGINE_VERSION,
+    "libc",
+    MM_ENGINE_THREADSAFE,
+    engine_init,
+    engine_malloc,
+    free,
+    engine_realloc,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
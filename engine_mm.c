@@ -0,0 +1,44 @@
+/*
+ * engine_mm.c - mdriver engine for the mm.c allocator over memlib
+ *
+ * Any allocator with the mm.h interface can be built into an engine
+ * this way; ENGINE_NAME sets its column heading.
+ */
+#include "mm.h"
+#include "memlib.h"
+#include "mm_engine.h"
+
+#ifndef ENGINE_NAME
+#define ENGINE_NAME "mm"
+#endif
+
+static int initialized;     /* mem_init has run */
+
+static int engine_init(void)
+{
+    if (!initialized) {
+	mem_init();
+	initialized = 1;
+    }
+    mem_reset_brk();
+    return mm_init();
+}
+
+static size_t engine_heapsize(void)
+{
+    return mem_heapsize();
+}
+
+MM_ENGINE_EXPORT const mm_engine_t mm_engine = {
+    MM_ENGINE_VERSION,
+    ENGINE_NAME,
+    0,
+    engine_init,
+    mm_malloc,
+    mm_free,
+    mm_realloc,
+    engine_heapsize,
+    mm_checkheap,
+    mem_heap_lo,
+    mem_heap_hi
+};
@@ -1,31 +1,36 @@
 #!/usr/bin/env python3
+#
+# grade-malloc.py - grade one or more mdriver builds on the default suite
+#
+# Every (driver, trace) pair runs as "mdriver -g -a -f <trace> -J <json>"
+# on a pool of workers, each pinned to a core of its own while it runs,
+# so at most one replay times itself on a core at once. Results are
+# cached in .grade-cache by the hashes of the driver binary and of the
+# trace, so pairs that did not change since the last run are not run
+# again; -n ignores the cache. The drivers are listed side by side.
+#
+# usage: grade-malloc.py [-j jobs] [-n] [mdriver]...
+#
 
-import sys
+import argparse
+import concurrent.futures
+import functools
+import hashlib
+import json
 import os
-import re
-import io
+import queue
+import shutil
 import subprocess
-import pprint
+import sys
+import tempfile
 
 debug = os.getenv("DEBUG") or False
 
-os.system("make")
-
-TRACES = [
-    "binary-bal.rep",
-    "binary2-bal.rep",
-    "cccp-bal.rep",
-    "coalescing-bal.rep",
-    "cp-decl-bal.rep",
-    "random-bal.rep",
-    "random2-bal.rep",
-    "realloc-bal.rep",
-    "realloc2-bal.rep"
-]
+CACHEDIR = ".grade-cache"
+MDRIVER_ARGS = ["-g", "-a"]
 
-reCorrect = re.compile(r"correct:(\d+)")
-rePerfidx = re.compile(r"perfidx:(\d+)")
-reTerm = re.compile(r"Terminated with")
+# Workers pin their replays with taskset; without it they run unpinned
+TASKSET = shutil.which("taskset")
 
 
 #
@@ -36,66 +41,110 @@ if debug:
     print('traces', TRACEDIR)
 
 
+def readSuite(path, suite):
+    """The trace names of suite in the manifest at path, in order"""
+    traces = []
+    current = None
+    with open(path) as f:
+        for line in f:
+            line = line.split("#")[0].strip()
+            if line.startswith("["):
+                current = line.strip("[]")
+            elif line and current == suite:
+                traces.append(line.split()[0])
+    return traces
+
+
+# The graded traces are the default suite of mdriver's manifest
+SUITEFILE = os.path.join(TRACEDIR, "suites")
+if not os.path.isfile(SUITEFILE):
+    SUITEFILE = os.path.join("traces", "suites")
+TRACES = readSuite(SUITEFILE, "default")
+
+
 def is_exe(fpath):
     return os.path.isfile(fpath) and os.access(fpath, os.X_OK)
 
 
-MDRIVERS = ['./mdriver']
-if len(sys.argv) > 1:
-    MDRIVERS = [file for file in sys.argv[1:] if is_exe(file)]
+parser = argparse.ArgumentParser(description="Grade mdriver builds")
+parser.add_argument("-j", type=int, default=len(os.sched_getaffinity(0)),
+                    help="parallel jobs (default: number of cores)")
+parser.add_argument("-n", action="store_true",
+                    help="run every pair again instead of using the cache")
+parser.add_argument("mdrivers", nargs="*", default=["./mdriver"])
+args = parser.parse_args()
+
+os.system("make")
+
+MDRIVERS = [file for file in args.mdrivers if is_exe(file)]
+
+
+@functools.lru_cache(maxsize=None)
+def fileHash(path):
+    with open(path, "rb") as f:
+        return hashlib.sha256(f.read()).hexdigest()
 
 
-def runCmd(cmd):
-    proc = subprocess.Popen(cmd, bufsize=0, text=True, stdout=subprocess.PIPE)
+def runCmd(cmd, core):
+    """Run cmd pinned to core; return its JSON results, or None"""
+    fd, out = tempfile.mkstemp(suffix=".json")
+    os.close(fd)
+    if TASKSET:
+        cmd = [TASKSET, "-c", str(core)] + cmd
     try:
-        stdout, stderr = proc.communicate(timeout=60)
+        proc = subprocess.run(cmd + ["-J", out], text=True,
+                              capture_output=True, timeout=60)
         if proc.returncode != 0:
             ##
             ## For failure, we assume no output
             ##
             if debug: print(f"Running {cmd} returned {proc.returncode}")
-            return "", ""
+            return None
+        if debug: print(proc.stdout)
+        with open(out) as f:
+            return json.load(f)
     except subprocess.TimeoutExpired:
-        print("Timeout running command:", cmd)
-        proc.kill()
-        stdout = ""
-        stderr = ""
-    return stdout, stderr
+        print("Timeout running command:", " ".join(cmd))
+        return None
+    except ValueError:
+        return None
+    finally:
+        os.remove(out)
 
 
-def runTrace(program, tracefile):
+def runTrace(program, tracefile, cores):
+    """(correct, perfidx) of program on tracefile, from the cache if the
+    binary and the trace are unchanged"""
     if debug:
         print("Run", program, "on", tracefile)
     if not is_exe(program):
         print(f"Your program file {program} does not exist or is not executable")
         return False, None
 
-    test_out, test_err = runCmd([program,
-                                 "-g",
-                                 "-a",
-                                 "-f", os.path.join(TRACEDIR, tracefile)])
-
-    test = io.StringIO(test_out)
-
-    perfidx = None
-    correct = False
-    for line in test:
-        if debug:
-            print("output:", line.strip())
-        term = reTerm.match(line)
-        if term:
-            if debug: print(f"Program terminated: {line}")
-            return 0,0
-        cor = reCorrect.match(line)
-        if cor:
-            correct = cor.group(1)
-        else:
-            per = rePerfidx.match(line)
-            if per:
-                perfidx = per.group(1)
-            else:
-                print(line.strip())
-    return correct, perfidx
+    path = os.path.join(TRACEDIR, tracefile)
+    key = hashlib.sha256(" ".join([fileHash(program), fileHash(path)] +
+                                  MDRIVER_ARGS).encode()).hexdigest()
+    cached = os.path.join(CACHEDIR, key + ".json")
+    if not args.n and os.path.isfile(cached):
+        with open(cached) as f:
+            result = json.load(f)
+    else:
+        core = cores.get()
+        try:
+            result = runCmd([program] + MDRIVER_ARGS + ["-f", path], core)
+        finally:
+            cores.put(core)
+        if result is None:
+            return False, None
+        os.makedirs(CACHEDIR, exist_ok=True)
+        with open(cached + ".tmp", "w") as f:
+            json.dump(result, f)
+        os.replace(cached + ".tmp", cached)
+
+    if result["errors"] != 0:
+        return 0, 0
+    return result["correct"] == 1, round(result["perfidx"])
+
 
 def computeScore(x):
     if len(x) != 9:
@@ -118,21 +167,37 @@ def computeScore(x):
     print(binary, ",", prog, ",", coal, ",", rand, ",", realloc)
     return min(110, 0.00574 + binary * 0.108 + prog * 0.728 + coal * -1.012 + rand * 0.769 + realloc * 0.574)
 
+# One worker per core at most; each takes a core for as long as it runs
+cores = queue.Queue()
+for core in sorted(os.sched_getaffinity(0))[:max(args.j, 1)]:
+    cores.put(core)
+pairs = [(mdriver, trace) for mdriver in MDRIVERS for trace in TRACES]
+with concurrent.futures.ThreadPoolExecutor(cores.qsize()) as pool:
+    results = dict(zip(pairs, pool.map(lambda p: runTrace(p[0], p[1], cores),
+                                       pairs)))
+
 perfDict = {}
 for mdriver in MDRIVERS:
-    performanceList = []
-    allCorrect = True
-    for trace in TRACES:
-        correct, perfidx = runTrace(mdriver, trace)
-        allCorrect = allCorrect and correct
-        performanceList.append(perfidx)
-    if allCorrect:
-        perfDict[mdriver] = [int(x) for x in performanceList]
+    runs = [results[(mdriver, trace)] for trace in TRACES]
+    if all(correct for correct, _ in runs):
+        perfDict[mdriver] = [int(perfidx) for _, perfidx in runs]
     else:
         print("%-20s:" % (mdriver), "failed")
 
-#print(perfDict)
+grades = {}
 for mdriver in perfDict.keys():
     trimmed = perfDict[mdriver]
-    score = min(110, computeScore(trimmed))
-    print(f"Grade {mdriver:<30s} {score:3.1f}")
+    grades[mdriver] = min(110, computeScore(trimmed))
+
+# The per-trace perf index of every driver, side by side
+width = max([12] + [len(m) + 2 for m in MDRIVERS])
+print("%-20s" % "trace" + "".join("%*s" % (width, m) for m in MDRIVERS))
+for trace in TRACES:
+    row = []
+    for mdriver in MDRIVERS:
+        correct, perfidx = results[(mdriver, trace)]
+        row.append("%*s" % (width, perfidx if correct else "failed"))
+    print("%-20s" % trace + "".join(row))
+print("%-20s" % "Grade" + "".join(
+    "%*s" % (width, "%3.1f" % grades[m] if m in grades else "failed")
+    for m in MDRIVERS))
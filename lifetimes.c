@@ -0,0 +1,162 @@
+/*
+ * lifetimes.c - derive oracle lifetime hints from .rep traces
+ *
+ * For every block id in a trace, measures how many requests pass
+ * between its allocation and its free, and writes <trace>.hints with
+ * one MM_HINT_* value per id, which "mdriver -H" passes to
+ * mm_malloc_hint(). Since the hints come from the trace itself, a run
+ * with them is an upper bound on what lifetime prediction can gain.
+ *
+ * An id is short-lived if it is freed within -s requests of being
+ * allocated, long-lived if it lives for at least the -l fraction of
+ * the trace or is never freed, and unknown otherwise. A hint is per
+ * id, not per allocation: when a trace frees an id and allocates it
+ * again, the id's last allocation decides its hint.
+ *
+ * usage: lifetimes [-v] [-s <requests>] [-l <fraction>] <trace.rep>...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "traceio.h"
+
+/* function prototypes */
+static int write_hints(const char *path, long short_ops, double long_frac);
+static void usage(void);
+
+static int verbose = 0;
+
+int main(int argc, char **argv)
+{
+    long short_ops = 64;
+    double long_frac = 0.25;
+    int c, status = 0;
+
+    while ((c = getopt(argc, argv, "s:l:vh")) != -1) {
+	switch (c) {
+	case 's':
+	    short_ops = strtol(optarg, NULL, 0);
+	    break;
+	case 'l':
+	    long_frac = atof(optarg);
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (optind == argc) {
+	usage();
+	exit(1);
+    }
+    for (; optind < argc; optind++)
+	if (write_hints(argv[optind], short_ops, long_frac) < 0)
+	    status = 1;
+    return status;
+}
+
+/*
+ * write_hints - classify the ids of the trace at path and write
+ *    path.hints. Returns 0 on success, -1 on error.
+ */
+static int write_hints(const char *path, long short_ops, double long_frac)
+{
+    rep_t *rep;
+    long *born;
+    unsigned char *hints;
+    long count[3] = {0, 0, 0};
+    long long_ops;
+    char out[1024];
+    FILE *fp;
+    int i;
+
+    if ((rep = rep_read(path)) == NULL)
+	return -1;
+    born = (long *)malloc(rep->num_ids * sizeof(long));
+    hints = (unsigned char *)malloc(rep->num_ids);
+    if (born == NULL || hints == NULL) {
+	fprintf(stderr, "%s: out of memory\n", path);
+	exit(1);
+    }
+    long_ops = (long)(long_frac * rep->num_ops);
+
+    /* Ids that are never freed live to the end of the trace */
+    for (i = 0; i < rep->num_ids; i++) {
+	born[i] = -1;
+	hints[i] = MM_HINT_LONG;
+    }
+    for (i = 0; i < rep->num_ops; i++) {
+	rep_op_t *op = &rep->ops[i];
+	long age;
+
+	if (op->index < 0)  /* free(NULL) */
+	    continue;
+	if (op->index >= rep->num_ids) {
+	    fprintf(stderr, "%s: id %d out of range\n", path, op->index);
+	    goto fail;
+	}
+	/* A realloc of an id that is not live is realloc(NULL, size),
+	   which is where that id is born */
+	if (op->type == REP_ALLOC ||
+	    (op->type == REP_REALLOC && born[op->index] < 0)) {
+	    born[op->index] = i;
+	    hints[op->index] = MM_HINT_LONG;
+	} else if (op->type == REP_FREE && born[op->index] >= 0) {
+	    age = i - born[op->index];
+	    if (age <= short_ops)
+		hints[op->index] = MM_HINT_SHORT;
+	    else if (age < long_ops)
+		hints[op->index] = MM_HINT_UNKNOWN;
+	    born[op->index] = -1;
+	}
+    }
+
+    snprintf(out, sizeof(out), "%s.hints", path);
+    if ((fp = fopen(out, "w")) == NULL) {
+	fprintf(stderr, "%s: cannot create\n", out);
+	goto fail;
+    }
+    fprintf(fp, "%d\n", rep->num_ids);
+    for (i = 0; i < rep->num_ids; i++) {
+	fprintf(fp, "%d\n", hints[i]);
+	count[hints[i]]++;
+    }
+    if (fclose(fp) != 0) {
+	fprintf(stderr, "%s: write failed\n", out);
+	goto fail;
+    }
+    if (verbose)
+	printf("%s: %d ids, %ld short, %ld long, %ld unknown\n", path,
+	       rep->num_ids, count[MM_HINT_SHORT], count[MM_HINT_LONG],
+	       count[MM_HINT_UNKNOWN]);
+
+    free(born);
+    free(hints);
+    rep_free(rep);
+    return 0;
+
+fail:
+    free(born);
+    free(hints);
+    rep_free(rep);
+    return -1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: lifetimes [-v] [-s <requests>] [-l <fraction>] "
+	    "<trace.rep>...\n");
+    fprintf(stderr, "\t-s <n>     Short-lived if freed within <n> requests "
+	    "(default 64).\n");
+    fprintf(stderr, "\t-l <f>     Long-lived if alive for <f> of the trace "
+	    "(default 0.25).\n");
+    fprintf(stderr, "\t-v         Print a summary per trace.\n");
+}
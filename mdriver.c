@@ -15,11 +15,19 @@
 #include <assert.h>
 #include <float.h>
 #include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
 #include "config.h"
+#include "mm_engine.h"
+#include "traceio.h"
 
 /**********************
  * Constants and macros
@@ -30,6 +38,7 @@
 #define MAXPATH 1024			/* maximum path length */
 #define HDRLINES 4		   /* number of header lines in a trace file */
 #define LINENUM(i) (i + 5) /* cnvt trace request nums to linenums (origin 1) */
+#define MAXENGINES 8	   /* max number of -e engines */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p) ((((uintptr_t)(p)) % ALIGNMENT) == 0)
@@ -70,6 +79,7 @@ typedef struct
 	traceop_t *ops;		 /* array of requests */
 	char **blocks;		 /* array of ptrs returned by malloc/realloc... */
 	size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+	unsigned char *hints; /* lifetime hint per id, or NULL (see -H) */
 } trace_t;
 
 /* 
@@ -81,6 +91,8 @@ typedef struct
 {
 	trace_t *trace;
 	range_t *ranges;
+	const mm_engine_t *engine; /* for eval_engine_speed */
+	int access;				   /* run the -A access model as well */
 } speed_t;
 
 /* Summarizes the important stats for some malloc function on some trace */
@@ -94,6 +106,9 @@ typedef struct
 	/* defined only for the student malloc package */
 	double util; /* space utilization for this trace (always 0 for libc) */
 
+	/* defined only with -A */
+	double access_secs; /* secs to run the trace with the access model */
+
 	/* Note: secs and util are only defined if valid is true */
 } stats_t;
 
@@ -104,12 +119,47 @@ int verbose = 0;	   /* global flag for verbose output */
 static int errors = 0; /* number of errs found when running student malloc */
 char msg[MAXLINE];	   /* for whenever we need to compose an error message */
 
+/* Call mm_checkheap every this many ops in eval_mm_valid (0 = never) */
+static int sample_check_interval = 0; /* sampled check, set by -c */
+static int full_check_interval = 0;	  /* full check, set by -C */
+
+/* Allocate with the oracle lifetime hints in <trace>.hints (set by -H) */
+static int use_hints = 0;
+
+/* Multi-threaded replay with 1..max_threads threads (set by -T) */
+static int max_threads = 0;
+static int partition_ids = 0; /* split the ids among threads (set by -P) */
+static int xfree_percent = 0; /* frees handed to another thread (set by -X) */
+
+/* Application access model during timed replays (set by -A) */
+#define ACCESS_NONE 0
+#define ACCESS_RECENT 1 /* the most recently allocated live blocks */
+#define ACCESS_RANDOM 2 /* live blocks chosen at random */
+static int access_model = ACCESS_NONE;
+static int access_period = 16; /* requests between periodic accesses */
+static int access_count = 8;   /* blocks touched by each periodic access */
+
+/* Fully check the data kept by every this many reallocs (set by -K) */
+static int verify_every = 1;
+
+/* Measure utilization in the validation pass (set by -F) */
+static int single_pass = 0;
+
+/* Run the timed replays in a child process (set by -i) */
+static int isolate_timing = 0;
+
+/* Replay the traces this many times on one heap (set by -S) */
+static int soak_iterations = 0;
+
+/* Allocator engines loaded with -e */
+static const mm_engine_t *engines[MAXENGINES];
+static int num_engines = 0;
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
-/* The filenames of the default tracefiles */
-static const char *default_tracefiles[] = {
-	DEFAULT_TRACEFILES, NULL};
+/* Weight of each trace in the totals and the performance index */
+static double *trace_weights = NULL;
 
 /********************* 
  * Function prototypes 
@@ -117,13 +167,18 @@ static const char *default_tracefiles[] = {
 
 /* these functions manipulate range lists */
 static int add_range(range_t **ranges, char *lo, int size,
-					 int tracenum, int opnum);
+					 const mm_engine_t *engine, int tracenum, int opnum);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
 
 /* These functions read, allocate, and free storage for traces */
+static int read_suite(char *tracedir, const char *suite, char ***tracefiles);
 static trace_t *read_trace(char *tracedir, char *filename);
+static void read_trace_bin(trace_t *trace, char *path);
+static void alloc_blocks(trace_t *trace, char *path);
+static void read_hints(trace_t *trace, char *path);
 static void free_trace(trace_t *trace);
+static void clear_blocks(trace_t *trace);
 
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
@@ -131,12 +186,47 @@ static void eval_libc_speed(void *ptr);
 
 /* Routines for evaluating correctnes, space utilization, and speed 
    of the student's malloc package in mm.c */
-static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
+static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges,
+						 double *util);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
+static int check_heap(const mm_engine_t *engine, int tracenum, int opnum);
+static double time_replay(fsecs_test_funct f, speed_t *params);
+
+/* Pattern checks for eval_mm_valid */
+static void init_find_mismatch(void);
+static int check_preserved(const char *p, int c, size_t n);
+
+/* Routines for loading and evaluating -e engines */
+static void load_engine(const char *path);
+static int eval_engine_valid(const mm_engine_t *engine, trace_t *trace,
+							 int tracenum, range_t **ranges);
+static int engine_error(const mm_engine_t *engine, int tracenum, int opnum,
+						const char *msg);
+static double eval_engine_util(const mm_engine_t *engine, trace_t *trace);
+static void eval_engine_speed(void *ptr);
+static void *trace_malloc(trace_t *trace, int index, int size);
+static void *trace_realloc(trace_t *trace, int index, void *ptr, int size);
+
+/* Application access model (-A) */
+static void parse_access(const char *arg);
+static void access_step(trace_t *trace, int opnum);
+
+/* Multi-threaded replay (-T) */
+static void eval_mt(int n, char **tracefiles);
+
+/* Soak mode (-S) */
+static void eval_soak(int n, char **tracefiles);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printcompare(int n, char **tracefiles, stats_t *mm_stats,
+						 stats_t *libc_stats, stats_t **engine_stats);
+static void printaccess(int n, char **tracefiles, stats_t *mm_stats,
+						stats_t *libc_stats, stats_t **engine_stats);
+static void write_json(const char *path, int n, char **tracefiles,
+					   stats_t *stats, double util, double kops,
+					   double perfindex, int numcorrect);
 static void usage(void);
 static void unix_error(const char *msg);
 static void malloc_error(int tracenum, int opnum, const char *msg);
@@ -147,34 +237,41 @@ static void app_error(const char *msg);
  **************/
 int main(int argc, char **argv)
 {
-	int i;
+	int i, e;
 	char c;
 	char **tracefiles = NULL;	/* null-terminated array of trace file names */
 	int num_tracefiles = 0;		/* the number of traces in that array */
+	const char *suite = DEFAULT_SUITE; /* suite to run without -f (-s) */
 	trace_t *trace = NULL;		/* stores a single trace file in memory */
 	range_t *ranges = NULL;		/* keeps track of block extents for one trace */
 	stats_t *libc_stats = NULL; /* libc stats for each trace */
 	stats_t *mm_stats = NULL;	/* mm (i.e. student) stats for each trace */
+	stats_t *engine_stats[MAXENGINES]; /* stats for each -e engine */
 	speed_t speed_params;		/* input parameters to the xx_speed routines */
 
 	int team_check = 1; /* If set, check team structure (reset by -a) */
 	int run_libc = 0;	/* If set, run libc malloc (set by -l) */
 	int autograder = 0; /* If set, emit summary info for autograder (-g) */
+	const char *json_path = NULL; /* results as JSON to this file (-J) */
 
 	/* temporaries used to compute the performance index */
-	double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
+	double secs, ops, util, weights, avg_mm_util, avg_mm_throughput, p1, p2,
+		perfindex;
 	int numcorrect;
 
 	/* 
      * Read and interpret the command line arguments 
      */
-	while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF)
+	while ((c = getopt(argc, argv, "f:s:t:c:C:e:T:X:S:A:K:J:hvVgalHPFi")) != EOF)
 	{
 		switch (c)
 		{
 		case 'g': /* Generate summary info for the autograder */
 			autograder = 1;
 			break;
+		case 'J': /* Write the results as JSON */
+			json_path = optarg;
+			break;
 		case 'f': /* Use one specific trace file only (relative to curr dir) */
 			num_tracefiles = 1;
 			if ((tracefiles = (char **)realloc(tracefiles, 2 * sizeof(char *))) == NULL)
@@ -185,6 +282,9 @@ int main(int argc, char **argv)
 			tracefiles[0] = strdup(optarg);
 			tracefiles[1] = NULL;
 			break;
+		case 's': /* Use the traces of a suite in the manifest */
+			suite = optarg;
+			break;
 		case 't':					 /* Directory where the traces are located */
 			if (num_tracefiles == 1) /* ignore if -f already encountered */
 				break;
@@ -192,6 +292,44 @@ int main(int argc, char **argv)
 			if (tracedir[strlen(tracedir) - 1] != '/')
 				strcat(tracedir, "/"); /* path always ends with "/" */
 			break;
+		case 'c': /* Sampled heap check every n ops */
+			sample_check_interval = atoi(optarg);
+			break;
+		case 'C': /* Full heap check every n ops */
+			full_check_interval = atoi(optarg);
+			break;
+		case 'e': /* Also run the allocator engine in a shared object */
+			load_engine(optarg);
+			break;
+		case 'T': /* Multi-threaded replay with up to n threads */
+			max_threads = atoi(optarg);
+			break;
+		case 'P': /* Multi-threaded replay partitions the ids */
+			partition_ids = 1;
+			break;
+		case 'X': /* Multi-threaded replay hands n% of frees across */
+			xfree_percent = atoi(optarg);
+			break;
+		case 'A': /* Touch payloads in timed replays as an application would */
+			parse_access(optarg);
+			break;
+		case 'K': /* Fully check only every kth realloc's data */
+			verify_every = atoi(optarg);
+			if (verify_every < 1)
+				verify_every = 1;
+			break;
+		case 'F': /* Validate and measure utilization in one pass */
+			single_pass = 1;
+			break;
+		case 'i': /* Time the replays in a child process */
+			isolate_timing = 1;
+			break;
+		case 'S': /* Replay the traces n times without resetting the heap */
+			soak_iterations = atoi(optarg);
+			break;
+		case 'H': /* Replay with oracle lifetime hints */
+			use_hints = 1;
+			break;
 		case 'a': /* Don't check team structure */
 			team_check = 0;
 			break;
@@ -245,18 +383,25 @@ int main(int argc, char **argv)
 	}
 
 	/* 
-     * If no -f command line arg, then use the entire set of tracefiles 
-     * defined in default_traces[]
+     * If no -f command line arg, then use the traces of the suite
+     * in the manifest, by default DEFAULT_SUITE
      */
 	if (tracefiles == NULL)
 	{
-		tracefiles = (char **)default_tracefiles;
-		num_tracefiles = sizeof(default_tracefiles) / sizeof(char *) - 1;
-		printf("Using default tracefiles in %s\n", tracedir);
+		num_tracefiles = read_suite(tracedir, suite, &tracefiles);
+		printf("Using the %s suite of tracefiles in %s\n", suite, tracedir);
+	}
+	else
+	{
+		if ((trace_weights = (double *)malloc(sizeof(double))) == NULL)
+			unix_error("malloc failed in main");
+		trace_weights[0] = 1;
 	}
 
 	/* Initialize the timing package */
 	init_fsecs();
+	init_find_mismatch();
+	speed_params.access = 0;
 
 	/*
      * Optionally run and evaluate the libc malloc package 
@@ -284,7 +429,14 @@ int main(int argc, char **argv)
 				speed_params.trace = trace;
 				if (verbose > 1)
 					printf("and performance.\n");
-				libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+				libc_stats[i].secs = time_replay(eval_libc_speed, &speed_params);
+				if (access_model != ACCESS_NONE)
+				{
+					speed_params.access = 1;
+					libc_stats[i].access_secs = time_replay(eval_libc_speed,
+													  &speed_params);
+					speed_params.access = 0;
+				}
 			}
 			free_trace(trace);
 		}
@@ -318,17 +470,25 @@ int main(int argc, char **argv)
 		mm_stats[i].ops = trace->num_ops;
 		if (verbose > 1)
 			printf("Checking mm_malloc for correctness, ");
-		mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
+		mm_stats[i].valid = eval_mm_valid(trace, i, &ranges,
+										  single_pass ? &mm_stats[i].util : NULL);
 		if (mm_stats[i].valid)
 		{
 			if (verbose > 1)
 				printf("efficiency, ");
-			mm_stats[i].util = eval_mm_util(trace, i, &ranges);
+			if (!single_pass)
+				mm_stats[i].util = eval_mm_util(trace, i, &ranges);
 			speed_params.trace = trace;
 			speed_params.ranges = ranges;
 			if (verbose > 1)
 				printf("and performance.\n");
-			mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
+			mm_stats[i].secs = time_replay(eval_mm_speed, &speed_params);
+			if (access_model != ACCESS_NONE)
+			{
+				speed_params.access = 1;
+				mm_stats[i].access_secs = time_replay(eval_mm_speed, &speed_params);
+				speed_params.access = 0;
+			}
 		}
 		free_trace(trace);
 	}
@@ -341,22 +501,77 @@ int main(int argc, char **argv)
 		printf("\n");
 	}
 
+	/*
+	 * Run the same traces through each -e engine and compare
+	 */
+	for (e = 0; e < num_engines; e++)
+	{
+		if (verbose > 1)
+			printf("\nTesting engine %s\n", engines[e]->name);
+		engine_stats[e] = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+		if (engine_stats[e] == NULL)
+			unix_error("engine_stats calloc in main failed");
+
+		for (i = 0; i < num_tracefiles; i++)
+		{
+			trace = read_trace(tracedir, tracefiles[i]);
+			engine_stats[e][i].ops = trace->num_ops;
+			engine_stats[e][i].valid = eval_engine_valid(engines[e], trace, i, &ranges);
+			if (engine_stats[e][i].valid)
+			{
+				engine_stats[e][i].util = eval_engine_util(engines[e], trace);
+				speed_params.trace = trace;
+				speed_params.engine = engines[e];
+				engine_stats[e][i].secs = time_replay(eval_engine_speed, &speed_params);
+				if (access_model != ACCESS_NONE)
+				{
+					speed_params.access = 1;
+					engine_stats[e][i].access_secs = time_replay(eval_engine_speed,
+														   &speed_params);
+					speed_params.access = 0;
+				}
+			}
+			free_trace(trace);
+		}
+	}
+	if (num_engines > 0)
+	{
+		printcompare(num_tracefiles, tracefiles, mm_stats,
+					 run_libc ? libc_stats : NULL, engine_stats);
+		printf("\n");
+	}
+
+	if (access_model != ACCESS_NONE)
+	{
+		printaccess(num_tracefiles, tracefiles, mm_stats,
+					run_libc ? libc_stats : NULL, engine_stats);
+		printf("\n");
+	}
+
+	if (max_threads > 0)
+		eval_mt(num_tracefiles, tracefiles);
+
+	if (soak_iterations > 0)
+		eval_soak(num_tracefiles, tracefiles);
+
 	/* 
      * Accumulate the aggregate statistics for the student's mm package 
      */
 	secs = 0;
 	ops = 0;
 	util = 0;
+	weights = 0;
 	numcorrect = 0;
 	for (i = 0; i < num_tracefiles; i++)
 	{
-		secs += mm_stats[i].secs;
-		ops += mm_stats[i].ops;
-		util += mm_stats[i].util;
+		secs += trace_weights[i] * mm_stats[i].secs;
+		ops += trace_weights[i] * mm_stats[i].ops;
+		util += trace_weights[i] * mm_stats[i].util;
+		weights += trace_weights[i];
 		if (mm_stats[i].valid)
 			numcorrect++;
 	}
-	avg_mm_util = util / num_tracefiles;
+	avg_mm_util = util / weights;
 
 	/* 
      * Compute and print the performance index 
@@ -384,6 +599,7 @@ int main(int argc, char **argv)
 	}
 	else
 	{ /* There were errors */
+		avg_mm_throughput = 0.0;
 		perfindex = 0.0;
 		printf("Terminated with %d errors\n", errors);
 	}
@@ -394,6 +610,11 @@ int main(int argc, char **argv)
 		printf("perfidx:%.0f\n", perfindex);
 	}
 
+	if (json_path != NULL)
+		write_json(json_path, num_tracefiles, tracefiles, mm_stats,
+				   avg_mm_util, avg_mm_throughput / 1e3, perfindex,
+				   numcorrect);
+
 	exit(0);
 }
 
@@ -408,11 +629,15 @@ int main(int argc, char **argv)
  *     we've just called the student's mm_malloc to allocate a block of 
  *     size bytes at addr lo. After checking the block for correctness,
  *     we create a range struct for this block and add it to the range list. 
+ *     If engine is not NULL, the block came from that engine instead; its
+ *     heap bounds are checked only if it exports them, and errors are
+ *     reported against the engine.
  */
 static int add_range(range_t **ranges, char *lo, int size,
-					 int tracenum, int opnum)
+					 const mm_engine_t *engine, int tracenum, int opnum)
 {
 	char *hi = lo + size - 1;
+	char *heap_lo, *heap_hi;
 	range_t *p;
 	char msg[MAXLINE];
 
@@ -423,18 +648,28 @@ static int add_range(range_t **ranges, char *lo, int size,
 	{
 		snprintf(msg, MAXLINE, "Payload address (%p) not aligned to %d bytes",
 				lo, ALIGNMENT);
-		malloc_error(tracenum, opnum, msg);
-		return 0;
+		goto fail;
 	}
 
 	/* The payload must lie within the extent of the heap */
-	if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-		(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi()))
+	if (engine == NULL)
+	{
+		heap_lo = (char *)mem_heap_lo();
+		heap_hi = (char *)mem_heap_hi();
+	}
+	else if (engine->heap_lo != NULL && engine->heap_hi != NULL)
+	{
+		heap_lo = (char *)engine->heap_lo();
+		heap_hi = (char *)engine->heap_hi();
+	}
+	else
+		heap_lo = heap_hi = NULL;
+	if (heap_lo != NULL &&
+		((lo < heap_lo) || (lo > heap_hi) || (hi < heap_lo) || (hi > heap_hi)))
 	{
 		snprintf(msg, MAXLINE, "Payload (%p:%p) lies outside heap (%p:%p)",
-				lo, hi, mem_heap_lo(), mem_heap_hi());
-		malloc_error(tracenum, opnum, msg);
-		return 0;
+				lo, hi, heap_lo, heap_hi);
+		goto fail;
 	}
 
 	/* The payload must not overlap any other payloads */
@@ -445,8 +680,7 @@ static int add_range(range_t **ranges, char *lo, int size,
 		{
 			snprintf(msg, MAXLINE, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
 					lo, hi, p->lo, p->hi);
-			malloc_error(tracenum, opnum, msg);
-			return 0;
+			goto fail;
 		}
 	}
 
@@ -461,6 +695,12 @@ static int add_range(range_t **ranges, char *lo, int size,
 	p->hi = hi;
 	*ranges = p;
 	return 1;
+
+fail:
+	if (engine != NULL)
+		return engine_error(engine, tracenum, opnum, msg);
+	malloc_error(tracenum, opnum, msg);
+	return 0;
 }
 
 /* 
@@ -504,6 +744,69 @@ static void clear_ranges(range_t **ranges)
  * The following routines manipulate tracefiles
  *********************************************/
 
+/*
+ * read_suite - read the names and weights of the traces in suite from
+ *     the manifest in tracedir. Returns the number of traces; the
+ *     names go to a NULL-terminated array in *tracefiles and the
+ *     weights to trace_weights.
+ */
+static int read_suite(char *tracedir, const char *suite, char ***tracefiles)
+{
+	FILE *file;
+	char path[MAXLINE + sizeof(SUITEFILE)], line[MAXLINE], name[MAXLINE];
+	int n = 0, lineno = 0, in_suite = 0, found = 0, fields;
+	double weight, total = 0;
+
+	snprintf(path, sizeof(path), "%s%s", tracedir, SUITEFILE);
+	if ((file = fopen(path, "r")) == NULL)
+	{
+		snprintf(msg, MAXLINE, "Could not open %.1024s in read_suite", path);
+		unix_error(msg);
+	}
+	*tracefiles = NULL;
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		char *hash = strchr(line, '#');
+
+		lineno++;
+		if (hash != NULL)
+			*hash = '\0';
+		if (sscanf(line, " [%[^]]]", name) == 1)
+		{
+			in_suite = (strcmp(name, suite) == 0);
+			found |= in_suite;
+			continue;
+		}
+		weight = 1;
+		if ((fields = sscanf(line, "%s %lf", name, &weight)) < 1 || !in_suite)
+			continue;
+		if (weight < 0)
+		{
+			snprintf(msg, MAXLINE, "%.1024s, line %d: negative weight", path,
+					 lineno);
+			app_error(msg);
+		}
+		*tracefiles = (char **)realloc(*tracefiles, (n + 2) * sizeof(char *));
+		trace_weights = (double *)realloc(trace_weights,
+										  (n + 1) * sizeof(double));
+		if (*tracefiles == NULL || trace_weights == NULL)
+			unix_error("realloc failed in read_suite");
+		(*tracefiles)[n] = strdup(name);
+		trace_weights[n] = weight;
+		total += weight;
+		(*tracefiles)[++n] = NULL;
+	}
+	fclose(file);
+
+	if (!found || total <= 0)
+	{
+		snprintf(msg, MAXLINE, "%.1024s: no suite %.100s, or it has no traces of "
+							   "nonzero weight", path, suite);
+		app_error(msg);
+	}
+	return n;
+}
+
 /*
  * read_trace - read a trace file and store it in memory
  */
@@ -524,8 +827,15 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	if ((trace = (trace_t *)malloc(sizeof(trace_t))) == NULL)
 		unix_error("malloc 1 failed in read_trance");
 
-	/* Read the trace file header */
+	/* Binary traces are read by traceio */
 	int lth = snprintf(path, sizeof(path), "%s%s", tracedir, filename);
+	if (lth >= 0 && rep_is_bin(path))
+	{
+		read_trace_bin(trace, path);
+		return trace;
+	}
+
+	/* Read the trace file header */
 	if (lth < 0 || (tracefile = fopen(path, "r")) == NULL)
 	{
 		snprintf(msg, MAXLINE, "Could not open %500s in read_trace", path);
@@ -553,16 +863,6 @@ static trace_t *read_trace(char *tracedir, char *filename)
 			 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
 		unix_error("malloc 2 failed in read_trace");
 
-	/* We'll keep an array of pointers to the allocated blocks here... */
-	if ((trace->blocks =
-			 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
-		unix_error("malloc 3 failed in read_trace");
-
-	/* ... along with the corresponding byte sizes of each block */
-	if ((trace->block_sizes =
-			 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
-		unix_error("malloc 4 failed in read_trace");
-
 	/* read every request line in the trace file */
 	index = 0;
 	op_index = 0;
@@ -590,7 +890,7 @@ static trace_t *read_trace(char *tracedir, char *filename)
 			trace->ops[op_index].size = size;
 			max_index = (index > max_index) ? index : max_index;
 			break;
-		case 'f':
+		case 'f': /* id -1 records a free(NULL) */
 			if (1 != fscanf(tracefile, "%ud", &index))
 			{
 				unix_error("fscanf of free\n");
@@ -609,9 +909,96 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	assert(max_index == trace->num_ids - 1);
 	assert(trace->num_ops == op_index);
 
+	alloc_blocks(trace, path);
 	return trace;
 }
 
+/*
+ * read_trace_bin - read a binary trace (see traceio.h) into trace
+ */
+static void read_trace_bin(trace_t *trace, char *path)
+{
+	rep_t *rep;
+	int i;
+
+	if ((rep = rep_read(path)) == NULL)
+		app_error("Could not read binary trace");
+	trace->sugg_heapsize = rep->sugg_heapsize;
+	trace->num_ids = rep->num_ids;
+	trace->num_ops = rep->num_ops;
+	trace->weight = rep->weight;
+	if ((trace->ops =
+			 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+		unix_error("malloc failed in read_trace_bin");
+	for (i = 0; i < rep->num_ops; i++)
+	{
+		rep_op_t *op = &rep->ops[i];
+
+		if (op->index >= trace->num_ids)
+			app_error("Binary trace has an id beyond its header");
+		trace->ops[i].type = (op->type == REP_ALLOC)	 ? ALLOC
+							 : (op->type == REP_FREE) ? FREE
+													  : REALLOC;
+		trace->ops[i].index = op->index;
+		trace->ops[i].size = op->size;
+	}
+	rep_free(rep);
+	alloc_blocks(trace, path);
+}
+
+/*
+ * alloc_blocks - set up the per-id arrays of a trace that has been read,
+ *     and its hints if they are in use
+ */
+static void alloc_blocks(trace_t *trace, char *path)
+{
+	/* We'll keep an array of pointers to the allocated blocks here...
+	   An id that is not live is NULL, since recorded traces realloc
+	   ids that were never allocated, as realloc(NULL, size) */
+	if ((trace->blocks =
+			 (char **)calloc(trace->num_ids, sizeof(char *))) == NULL)
+		unix_error("malloc 3 failed in read_trace");
+
+	/* ... along with the corresponding byte sizes of each block */
+	if ((trace->block_sizes =
+			 (size_t *)calloc(trace->num_ids, sizeof(size_t))) == NULL)
+		unix_error("malloc 4 failed in read_trace");
+
+	trace->hints = NULL;
+	if (use_hints)
+		read_hints(trace, path);
+}
+
+/*
+ * read_hints - read the lifetime hints that the lifetimes tool wrote
+ *     for the trace in path to path.hints
+ */
+static void read_hints(trace_t *trace, char *path)
+{
+	FILE *fp;
+	char hintpath[MAXPATH + 8];
+	int i, num_ids, hint;
+
+	snprintf(hintpath, sizeof(hintpath), "%s.hints", path);
+	if ((fp = fopen(hintpath, "r")) == NULL)
+	{
+		snprintf(msg, MAXLINE, "Could not open %500s (run ./lifetimes on "
+				 "the trace first)", hintpath);
+		unix_error(msg);
+	}
+	if (1 != fscanf(fp, "%d", &num_ids) || num_ids != trace->num_ids)
+		app_error("Hints file does not match the trace");
+	if ((trace->hints = (unsigned char *)malloc(num_ids)) == NULL)
+		unix_error("malloc failed in read_hints");
+	for (i = 0; i < num_ids; i++)
+	{
+		if (1 != fscanf(fp, "%d", &hint))
+			app_error("Hints file is truncated");
+		trace->hints[i] = hint;
+	}
+	fclose(fp);
+}
+
 /*
  * free_trace - Free the trace record and the three arrays it points
  *              to, all of which were allocated in read_trace().
@@ -621,29 +1008,47 @@ void free_trace(trace_t *trace)
 	free(trace->ops); /* free the three arrays... */
 	free(trace->blocks);
 	free(trace->block_sizes);
+	free(trace->hints);
 	free(trace); /* and the trace record itself... */
 }
 
+/*
+ * clear_blocks - Forget the blocks of a previous run of the trace, so
+ *     that an id which is reallocated before it is allocated starts
+ *     out as NULL
+ */
+static void clear_blocks(trace_t *trace)
+{
+	memset(trace->blocks, 0, trace->num_ids * sizeof(char *));
+	memset(trace->block_sizes, 0, trace->num_ids * sizeof(size_t));
+}
+
 /**********************************************************************
  * The following functions evaluate the correctness, space utilization,
  * and throughput of the libc and mm malloc packages.
  **********************************************************************/
 
 /*
- * eval_mm_valid - Check the mm malloc package for correctness
+ * eval_mm_valid - Check the mm malloc package for correctness. If util
+ *     is not NULL, also measure the space utilization as eval_mm_util
+ *     does and store it there, which saves a replay of the trace.
  */
-static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
+static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges,
+						 double *util)
 {
-	int i, j;
+	int i;
 	int index;
 	int size;
 	int oldsize;
 	char *newp;
 	char *oldp;
 	char *p;
+	int total_size = 0;
+	int max_total_size = 0;
 
 	/* Reset the heap and free any records in the range list */
 	mem_reset_brk();
+	clear_blocks(trace);
 	clear_ranges(ranges);
 
 	/* Call the mm package's init function */
@@ -665,7 +1070,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 		case ALLOC: /* mm_malloc */
 
 			/* Call the student's malloc */
-			if ((p = (char *)mm_malloc(size)) == NULL)
+			if ((p = (char *)trace_malloc(trace, index, size)) == NULL)
 			{
 				malloc_error(tracenum, i, "mm_malloc failed.");
 				return 0;
@@ -676,7 +1081,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	     * to the range list if OK. The block must be  be aligned properly,
 	     * and must not overlap any currently allocated block. 
 	     */
-			if (add_range(ranges, p, size, tracenum, i) == 0)
+			if (add_range(ranges, p, size, NULL, tracenum, i) == 0)
 				return 0;
 
 			/* ADDED: cgw
@@ -689,13 +1094,14 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 			/* Remember region */
 			trace->blocks[index] = p;
 			trace->block_sizes[index] = size;
+			total_size += size;
 			break;
 
 		case REALLOC: /* mm_realloc */
 
 			/* Call the student's realloc */
 			oldp = trace->blocks[index];
-			if ((newp = (char *)mm_realloc(oldp, size)) == NULL)
+			if ((newp = (char *)trace_realloc(trace, index, oldp, size)) == NULL)
 			{
 				malloc_error(tracenum, i, "mm_realloc failed.");
 				return 0;
@@ -705,7 +1111,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 			remove_range(ranges, oldp);
 
 			/* Check new block for correctness and add it to range list */
-			if (add_range(ranges, newp, size, tracenum, i) == 0)
+			if (add_range(ranges, newp, size, NULL, tracenum, i) == 0)
 				return 0;
 
 			/* ADDED: cgw
@@ -716,18 +1122,16 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 			oldsize = trace->block_sizes[index];
 			if (size < oldsize)
 				oldsize = size;
-			for (j = 0; j < oldsize; j++)
+			if (!check_preserved(newp, index & 0xFF, oldsize))
 			{
-				if (newp[j] != (index & 0xFF))
-				{
-					malloc_error(tracenum, i, "mm_realloc did not preserve the "
-											  "data from old block");
-					return 0;
-				}
+				malloc_error(tracenum, i, "mm_realloc did not preserve the "
+										  "data from old block");
+				return 0;
 			}
 			memset(newp, index & 0xFF, size);
 
 			/* Remember region */
+			total_size += size - trace->block_sizes[index];
 			trace->blocks[index] = newp;
 			trace->block_sizes[index] = size;
 			break;
@@ -735,20 +1139,264 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 		case FREE: /* mm_free */
 
 			/* Remove region from list and call student's free function */
+			if (index < 0) /* free(NULL) */
+				break;
 			p = trace->blocks[index];
 			remove_range(ranges, p);
 			mm_free(p);
+			total_size -= trace->block_sizes[index];
+			trace->blocks[index] = NULL;
+			trace->block_sizes[index] = 0;
 			break;
 
 		default:
 			app_error("Nonexistent request type in eval_mm_valid");
 		}
+
+		if (total_size > max_total_size)
+			max_total_size = total_size;
+		if (check_heap(NULL, tracenum, i) == 0)
+			return 0;
+	}
+
+	/* Finish with a full check if any checking was requested */
+	if ((sample_check_interval || full_check_interval) &&
+		mm_checkheap(MM_CHECK_LISTS) < 0)
+	{
+		malloc_error(tracenum, trace->num_ops - 1, "mm_checkheap failed "
+												   "at end of trace");
+		return 0;
 	}
 
+	if (util != NULL)
+		*util = (double)max_total_size / (double)mem_heapsize();
+
 	/* As far as we know, this is a valid malloc package */
 	return 1;
 }
 
+/*
+ * check_heap - Run mm_checkheap, or engine's checkheap if engine is not
+ *     NULL, after request opnum if the -c or -C interval says so.
+ *     Returns 0 if the heap checker found a problem.
+ */
+static int check_heap(const mm_engine_t *engine, int tracenum, int opnum)
+{
+	int level;
+
+	if (engine != NULL && engine->checkheap == NULL)
+		return 1;
+
+	if (full_check_interval && (opnum + 1) % full_check_interval == 0)
+		level = MM_CHECK_LISTS;
+	else if (sample_check_interval && (opnum + 1) % sample_check_interval == 0)
+		level = MM_CHECK_SAMPLE;
+	else
+		return 1;
+
+	if (engine != NULL)
+	{
+		if (engine->checkheap(level) < 0)
+			return engine_error(engine, tracenum, opnum, "checkheap failed.");
+		return 1;
+	}
+	if (mm_checkheap(level) < 0)
+	{
+		malloc_error(tracenum, opnum, "mm_checkheap failed.");
+		return 0;
+	}
+	return 1;
+}
+
+/**********************************************************************
+ * Pattern checks. find_mismatch returns the offset of the first byte
+ * of p[0..n) that is not c, or n if there is none. The SSE2 and AVX2
+ * versions compare 16 and 32 bytes at a time; init_find_mismatch picks
+ * the widest one the CPU supports.
+ **********************************************************************/
+
+#define VERIFY_EDGE 64 /* bytes checked at each end of a sampled block */
+
+static size_t (*find_mismatch)(const unsigned char *p, unsigned char c,
+							   size_t n);
+static const char *find_mismatch_name;
+
+static size_t find_mismatch_scalar(const unsigned char *p, unsigned char c,
+								   size_t n)
+{
+	uint64_t pattern = 0x0101010101010101ULL * c, word;
+	size_t i;
+
+	/* A word at a time, then the byte that differs or the tail */
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		memcpy(&word, p + i, 8);
+		if (word != pattern)
+			break;
+	}
+	for (; i < n; i++)
+		if (p[i] != c)
+			return i;
+	return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2"))) static size_t
+find_mismatch_sse2(const unsigned char *p, unsigned char c, size_t n)
+{
+	__m128i pattern = _mm_set1_epi8((char)c);
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+
+		if (mask != 0xffff)
+			return i + __builtin_ctz(~mask);
+	}
+	return i + find_mismatch_scalar(p + i, c, n - i);
+}
+
+__attribute__((target("avx2"))) static size_t
+find_mismatch_avx2(const unsigned char *p, unsigned char c, size_t n)
+{
+	__m256i pattern = _mm256_set1_epi8((char)c);
+	size_t i = 0;
+
+	/* 128 bytes per iteration while they all match */
+	for (; i + 128 <= n; i += 128)
+	{
+		__m256i eq0 = _mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)(p + i)), pattern);
+		__m256i eq1 = _mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)(p + i + 32)), pattern);
+		__m256i eq2 = _mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)(p + i + 64)), pattern);
+		__m256i eq3 = _mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)(p + i + 96)), pattern);
+		__m256i all = _mm256_and_si256(_mm256_and_si256(eq0, eq1),
+									   _mm256_and_si256(eq2, eq3));
+
+		if ((unsigned)_mm256_movemask_epi8(all) != 0xffffffffu)
+			break;
+	}
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern));
+
+		if (mask != 0xffffffffu)
+			return i + __builtin_ctz(~mask);
+	}
+	return i + find_mismatch_scalar(p + i, c, n - i);
+}
+#endif
+
+/*
+ * init_find_mismatch - Pick the find_mismatch for this CPU
+ */
+static void init_find_mismatch(void)
+{
+	find_mismatch = find_mismatch_scalar;
+	find_mismatch_name = "scalar";
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		find_mismatch = find_mismatch_avx2;
+		find_mismatch_name = "avx2";
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		find_mismatch = find_mismatch_sse2;
+		find_mismatch_name = "sse2";
+	}
+#endif
+	if (verbose > 1)
+		printf("Checking payloads with the %s pattern check\n",
+			   find_mismatch_name);
+}
+
+/*
+ * check_preserved - Does p[0..n) hold nothing but c? With -K k, only
+ *     every kth call checks all of it; the others check the VERIFY_EDGE
+ *     bytes at each end, where a copy that is short or misplaced shows.
+ */
+static int check_preserved(const char *p, int c, size_t n)
+{
+	static unsigned long calls;
+	const unsigned char *q = (const unsigned char *)p;
+
+	if (verify_every > 1 && calls++ % verify_every != 0 &&
+		n > 2 * VERIFY_EDGE)
+		return find_mismatch(q, c, VERIFY_EDGE) == VERIFY_EDGE &&
+			   find_mismatch(q + n - VERIFY_EDGE, c, VERIFY_EDGE) == VERIFY_EDGE;
+	return find_mismatch(q, c, n) == n;
+}
+
+/*
+ * time_replay - Time f on params with fsecs. With -i, the timing runs
+ *     in a child process, which starts from a copy of the driver's
+ *     state and whose own allocations, page faults and cache misses
+ *     never reach the driver or the next measurement.
+ */
+static double time_replay(fsecs_test_funct f, speed_t *params)
+{
+	int fds[2], status;
+	double secs;
+	pid_t pid;
+
+	if (!isolate_timing)
+		return fsecs(f, params);
+
+	/* Buffered output would otherwise be printed by both processes */
+	fflush(stdout);
+	if (pipe(fds) < 0)
+		unix_error("pipe failed in time_replay");
+	if ((pid = fork()) < 0)
+		unix_error("fork failed in time_replay");
+	if (pid == 0)
+	{
+		close(fds[0]);
+		secs = fsecs(f, params);
+		if (write(fds[1], &secs, sizeof(secs)) != sizeof(secs))
+			_exit(1);
+		_exit(0);
+	}
+	close(fds[1]);
+	if (read(fds[0], &secs, sizeof(secs)) != sizeof(secs))
+		secs = -1;
+	close(fds[0]);
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+		WEXITSTATUS(status) != 0 || secs < 0)
+		app_error("timing child failed in time_replay");
+	return secs;
+}
+
+/*
+ * trace_malloc - Allocate block index of the trace, passing its lifetime
+ *     hint to mm_malloc_hint if -H was given
+ */
+static inline void *trace_malloc(trace_t *trace, int index, int size)
+{
+	if (trace->hints != NULL)
+		return mm_malloc_hint(size, trace->hints[index]);
+	return mm_malloc(size);
+}
+
+/*
+ * trace_realloc - Resize block index of the trace. A realloc of an id
+ *     that is not live is where that id is born, so it is allocated
+ *     with trace_malloc to pass its hint.
+ */
+static inline void *trace_realloc(trace_t *trace, int index, void *ptr, int size)
+{
+	if (ptr == NULL)
+		return trace_malloc(trace, index, size);
+	return mm_realloc(ptr, size);
+}
+
 /* 
  * eval_mm_util - Evaluate the space utilization of the student's package
  *   The idea is to remember the high water mark "hwm" of the heap for 
@@ -772,6 +1420,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 
 	/* initialize the heap and the mm malloc package */
 	mem_reset_brk();
+	clear_blocks(trace);
 	if (mm_init() < 0)
 		app_error("mm_init failed in eval_mm_util");
 
@@ -784,7 +1433,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 			index = trace->ops[i].index;
 			size = trace->ops[i].size;
 
-			if ((p = (char *)mm_malloc(size)) == NULL)
+			if ((p = (char *)trace_malloc(trace, index, size)) == NULL)
 				app_error("mm_malloc failed in eval_mm_util");
 
 			/* Remember region and size */
@@ -805,7 +1454,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 			oldsize = trace->block_sizes[index];
 
 			oldp = trace->blocks[index];
-			if ((newp = (char *)mm_realloc(oldp, newsize)) == NULL)
+			if ((newp = (char *)trace_realloc(trace, index, oldp, newsize)) == NULL)
 				app_error("mm_realloc failed in eval_mm_util");
 
 			/* Remember region and size */
@@ -822,10 +1471,14 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 
 		case FREE: /* mm_free */
 			index = trace->ops[i].index;
+			if (index < 0) /* free(NULL) */
+				break;
 			size = trace->block_sizes[index];
 			p = trace->blocks[index];
 
 			mm_free(p);
+			trace->blocks[index] = NULL;
+			trace->block_sizes[index] = 0;
 
 			/* Keep track of current total size
 	     * of all allocated blocks */
@@ -850,21 +1503,24 @@ static void eval_mm_speed(void *ptr)
 	int i, index, size, newsize;
 	char *p, *newp, *oldp, *block;
 	trace_t *trace = ((speed_t *)ptr)->trace;
+	int access = ((speed_t *)ptr)->access;
 
 	/* Reset the heap and initialize the mm package */
 	mem_reset_brk();
+	clear_blocks(trace);
 	if (mm_init() < 0)
 		app_error("mm_init failed in eval_mm_speed");
 
 	/* Interpret each trace request */
 	for (i = 0; i < trace->num_ops; i++)
+	{
 		switch (trace->ops[i].type)
 		{
 
 		case ALLOC: /* mm_malloc */
 			index = trace->ops[i].index;
 			size = trace->ops[i].size;
-			if ((p = (char *)mm_malloc(size)) == NULL)
+			if ((p = (char *)trace_malloc(trace, index, size)) == NULL)
 				app_error("mm_malloc error in eval_mm_speed");
 			trace->blocks[index] = p;
 			break;
@@ -873,20 +1529,26 @@ static void eval_mm_speed(void *ptr)
 			index = trace->ops[i].index;
 			newsize = trace->ops[i].size;
 			oldp = trace->blocks[index];
-			if ((newp = (char *)mm_realloc(oldp, newsize)) == NULL)
+			if ((newp = (char *)trace_realloc(trace, index, oldp, newsize)) == NULL)
 				app_error("mm_realloc error in eval_mm_speed");
 			trace->blocks[index] = newp;
 			break;
 
 		case FREE: /* mm_free */
 			index = trace->ops[i].index;
+			if (index < 0) /* free(NULL) */
+				break;
 			block = trace->blocks[index];
 			mm_free(block);
+			trace->blocks[index] = NULL;
 			break;
 
 		default:
 			app_error("Nonexistent request type in eval_mm_valid");
 		}
+		if (access)
+			access_step(trace, i);
+	}
 }
 
 /*
@@ -900,6 +1562,7 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 	int i, newsize;
 	char *p, *newp, *oldp;
 
+	clear_blocks(trace);
 	for (i = 0; i < trace->num_ops; i++)
 	{
 		switch (trace->ops[i].type)
@@ -926,7 +1589,10 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 			break;
 
 		case FREE: /* free */
+			if (trace->ops[i].index < 0) /* free(NULL) */
+				break;
 			free(trace->blocks[trace->ops[i].index]);
+			trace->blocks[trace->ops[i].index] = NULL;
 			break;
 
 		default:
@@ -948,7 +1614,9 @@ static void eval_libc_speed(void *ptr)
 	int index, size, newsize;
 	char *p, *newp, *oldp, *block;
 	trace_t *trace = ((speed_t *)ptr)->trace;
+	int access = ((speed_t *)ptr)->access;
 
+	clear_blocks(trace);
 	for (i = 0; i < trace->num_ops; i++)
 	{
 		switch (trace->ops[i].type)
@@ -973,44 +1641,926 @@ static void eval_libc_speed(void *ptr)
 
 		case FREE: /* free */
 			index = trace->ops[i].index;
+			if (index < 0) /* free(NULL) */
+				break;
 			block = trace->blocks[index];
 			free(block);
+			trace->blocks[index] = NULL;
 			break;
 		}
+		if (access)
+			access_step(trace, i);
 	}
 }
 
-/*************************************
- * Some miscellaneous helper routines
- ************************************/
+/**********************************************************************
+ * Application access model. With -A, each timed replay is run a second
+ * time with payload accesses mixed in, as the program behind the trace
+ * would make them: every new or reallocated block is written one byte
+ * per cache line, and every access_period requests access_count live
+ * blocks are read and written, either the most recently allocated ones
+ * or ones chosen at random. The difference in time shows how much the
+ * cache and TLB locality of the allocator's placement costs.
+ **********************************************************************/
+
+#define ACCESS_LINE 64			/* bytes between touched addresses */
+#define ACCESS_NEW_BYTES 4096	/* bytes touched in a new block, at most */
+#define ACCESS_LIVE_BYTES 256	/* bytes touched in a live block, at most */
+#define ACCESS_RECENT_IDS 256	/* most recent allocations remembered */
+
+static int access_recent[ACCESS_RECENT_IDS]; /* ring of recent ids */
+static int access_next;						 /* next slot in the ring */
+static unsigned access_seed;
+static volatile char access_sink; /* keeps the reads alive */
 
 /*
- * printresults - prints a performance summary for some malloc package
+ * parse_access - Parse the -A argument, recent|random[:period[:count]]
  */
-static void printresults(int n, stats_t *stats)
+static void parse_access(const char *arg)
 {
-	int i;
-	double secs = 0;
-	double ops = 0;
-	double util = 0;
+	const char *rest = strchr(arg, ':');
+	size_t len = rest ? (size_t)(rest - arg) : strlen(arg);
 
-	/* Print the individual results for each trace */
-	printf("%5s%7s %5s%8s%10s%6s\n",
-		   "trace", " valid", "util", "ops", "secs", "Kops");
-	for (i = 0; i < n; i++)
+	if (len == 6 && strncmp(arg, "recent", len) == 0)
+		access_model = ACCESS_RECENT;
+	else if (len == 6 && strncmp(arg, "random", len) == 0)
+		access_model = ACCESS_RANDOM;
+	else
 	{
-		if (stats[i].valid)
-		{
-			printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n",
-				   i,
+		usage();
+		exit(1);
+	}
+	if (rest != NULL && sscanf(rest, ":%d:%d", &access_period,
+							   &access_count) < 1)
+	{
+		usage();
+		exit(1);
+	}
+	if (access_period < 1 || access_count < 0)
+	{
+		usage();
+		exit(1);
+	}
+}
+
+/*
+ * access_touch - Read and write one byte per cache line of the first
+ *     limit bytes of a payload of size bytes
+ */
+static inline void access_touch(char *p, size_t size, size_t limit)
+{
+	size_t j;
+	char sum = 0;
+
+	if (size > limit)
+		size = limit;
+	for (j = 0; j < size; j += ACCESS_LINE)
+	{
+		sum += p[j];
+		p[j] = (char)j;
+	}
+	access_sink += sum;
+}
+
+/*
+ * access_step - Make the accesses that follow request opnum of trace.
+ *     The speed routines only track block pointers, so the payload
+ *     sizes are kept here.
+ */
+static void access_step(trace_t *trace, int opnum)
+{
+	traceop_t *op = &trace->ops[opnum];
+	int k, index, tries;
+
+	if (opnum == 0)
+	{
+		memset(access_recent, -1, sizeof(access_recent));
+		access_next = 0;
+		access_seed = 1;
+	}
+	if (op->type != FREE)
+	{
+		trace->block_sizes[op->index] = op->size;
+		access_touch(trace->blocks[op->index], op->size, ACCESS_NEW_BYTES);
+		if (op->type == ALLOC)
+		{
+			access_recent[access_next] = op->index;
+			access_next = (access_next + 1) % ACCESS_RECENT_IDS;
+		}
+	}
+	if ((opnum + 1) % access_period != 0)
+		return;
+
+	/* Freed ids are skipped, with a bound on the misses */
+	for (k = 0, tries = 0; k < access_count && tries < 4 * access_count;
+		 tries++)
+	{
+		if (access_model == ACCESS_RECENT)
+			index = access_recent[(access_next + ACCESS_RECENT_IDS - 1 -
+								   tries % ACCESS_RECENT_IDS) %
+								  ACCESS_RECENT_IDS];
+		else
+		{
+			access_seed = access_seed * 1103515245 + 12345;
+			index = (access_seed >> 8) % trace->num_ids;
+		}
+		if (index < 0 || trace->blocks[index] == NULL)
+			continue;
+		access_touch(trace->blocks[index], trace->block_sizes[index],
+					 ACCESS_LIVE_BYTES);
+		k++;
+	}
+}
+
+/**********************************************************************
+ * The following functions load allocator engines from shared objects
+ * and evaluate their correctness, space utilization and throughput.
+ **********************************************************************/
+
+/*
+ * load_engine - dlopen the engine in path and add it to engines[]
+ */
+static void load_engine(const char *path)
+{
+	char file[MAXPATH];
+	void *handle;
+	const mm_engine_t *engine;
+
+	if (num_engines == MAXENGINES)
+		app_error("Too many -e engines");
+
+	/* Without a slash, dlopen would search the library path instead */
+	snprintf(file, sizeof(file), "%s%s", strchr(path, '/') ? "" : "./", path);
+	if ((handle = dlopen(file, RTLD_NOW | RTLD_LOCAL)) == NULL)
+	{
+		snprintf(msg, MAXLINE, "Could not load engine: %s", dlerror());
+		app_error(msg);
+	}
+	if ((engine = (const mm_engine_t *)dlsym(handle, MM_ENGINE_SYMBOL)) == NULL)
+	{
+		snprintf(msg, MAXLINE, "%s does not define %s", file, MM_ENGINE_SYMBOL);
+		app_error(msg);
+	}
+	if (engine->version != MM_ENGINE_VERSION)
+	{
+		snprintf(msg, MAXLINE, "%s has engine version %d, not %d", file,
+				 engine->version, MM_ENGINE_VERSION);
+		app_error(msg);
+	}
+	engines[num_engines++] = engine;
+}
+
+/*
+ * engine_error - Report a failure of an engine. Unlike malloc_error,
+ *     this does not count against the mm package's performance index.
+ */
+static int engine_error(const mm_engine_t *engine, int tracenum, int opnum,
+						const char *msg)
+{
+	printf("ERROR [engine %s, trace %d, line %d]: %s\n", engine->name,
+		   tracenum, LINENUM(opnum), msg);
+	return 0;
+}
+
+/*
+ * eval_engine_valid - Check an engine for correctness as eval_mm_valid
+ *     checks mm: payloads must be aligned, must not overlap, and must lie
+ *     within the engine's heap if it exports its bounds, realloc must
+ *     preserve the old contents, and -c/-C run the engine's checkheap
+ */
+static int eval_engine_valid(const mm_engine_t *engine, trace_t *trace,
+							 int tracenum, range_t **ranges)
+{
+	int i;
+	int index, size, oldsize;
+	char *p, *newp, *oldp;
+
+	clear_blocks(trace);
+	clear_ranges(ranges);
+	if (engine->init() < 0)
+		return engine_error(engine, tracenum, 0, "init failed.");
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+
+		switch (trace->ops[i].type)
+		{
+		case ALLOC:
+			if ((p = (char *)engine->malloc(size)) == NULL)
+				return engine_error(engine, tracenum, i, "malloc failed.");
+			if (add_range(ranges, p, size, engine, tracenum, i) == 0)
+				return 0;
+			memset(p, index & 0xFF, size);
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			break;
+
+		case REALLOC:
+			oldp = trace->blocks[index];
+			if ((newp = (char *)engine->realloc(oldp, size)) == NULL)
+				return engine_error(engine, tracenum, i, "realloc failed.");
+			remove_range(ranges, oldp);
+			if (add_range(ranges, newp, size, engine, tracenum, i) == 0)
+				return 0;
+			oldsize = trace->block_sizes[index];
+			if (size < oldsize)
+				oldsize = size;
+			if (!check_preserved(newp, index & 0xFF, oldsize))
+				return engine_error(engine, tracenum, i, "realloc did not "
+									"preserve the data from old block");
+			memset(newp, index & 0xFF, size);
+			trace->blocks[index] = newp;
+			trace->block_sizes[index] = size;
+			break;
+
+		case FREE:
+			if (index < 0) /* free(NULL) */
+				break;
+			p = trace->blocks[index];
+			remove_range(ranges, p);
+			engine->free(p);
+			trace->blocks[index] = NULL;
+			trace->block_sizes[index] = 0;
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_engine_valid");
+		}
+
+		if (check_heap(engine, tracenum, i) == 0)
+			return 0;
+	}
+
+	/* Finish with a full check if any checking was requested */
+	if ((sample_check_interval || full_check_interval) &&
+		engine->checkheap != NULL && engine->checkheap(MM_CHECK_LISTS) < 0)
+		return engine_error(engine, tracenum, trace->num_ops - 1,
+							"checkheap failed at end of trace");
+	return 1;
+}
+
+/*
+ * eval_engine_util - Space utilization of an engine, as eval_mm_util
+ *     measures it, or 0 if the engine does not report its heap size
+ */
+static double eval_engine_util(const mm_engine_t *engine, trace_t *trace)
+{
+	int i, index, size;
+	int max_total_size = 0;
+	int total_size = 0;
+	char *p;
+
+	if (engine->heapsize == NULL)
+		return 0;
+	clear_blocks(trace);
+	if (engine->init() < 0)
+		app_error("engine init failed in eval_engine_util");
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+
+		switch (trace->ops[i].type)
+		{
+		case ALLOC:
+			if ((p = (char *)engine->malloc(size)) == NULL)
+				app_error("engine malloc failed in eval_engine_util");
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			total_size += size;
+			break;
+
+		case REALLOC:
+			if ((p = (char *)engine->realloc(trace->blocks[index], size)) == NULL)
+				app_error("engine realloc failed in eval_engine_util");
+			total_size += size - trace->block_sizes[index];
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			break;
+
+		case FREE:
+			if (index < 0) /* free(NULL) */
+				break;
+			engine->free(trace->blocks[index]);
+			total_size -= trace->block_sizes[index];
+			trace->blocks[index] = NULL;
+			trace->block_sizes[index] = 0;
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_engine_util");
+		}
+		if (total_size > max_total_size)
+			max_total_size = total_size;
+	}
+
+	return ((double)max_total_size / (double)engine->heapsize());
+}
+
+/*
+ * eval_engine_speed - This is the function that is used by fcyc()
+ *    to measure the running time of an engine
+ */
+static void eval_engine_speed(void *ptr)
+{
+	int i, index;
+	char *p;
+	trace_t *trace = ((speed_t *)ptr)->trace;
+	const mm_engine_t *engine = ((speed_t *)ptr)->engine;
+	int access = ((speed_t *)ptr)->access;
+
+	clear_blocks(trace);
+	if (engine->init() < 0)
+		app_error("engine init failed in eval_engine_speed");
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		switch (trace->ops[i].type)
+		{
+		case ALLOC:
+			if ((p = (char *)engine->malloc(trace->ops[i].size)) == NULL)
+				app_error("engine malloc failed in eval_engine_speed");
+			trace->blocks[index] = p;
+			break;
+
+		case REALLOC:
+			if ((p = (char *)engine->realloc(trace->blocks[index],
+											 trace->ops[i].size)) == NULL)
+				app_error("engine realloc failed in eval_engine_speed");
+			trace->blocks[index] = p;
+			break;
+
+		case FREE:
+			if (index < 0) /* free(NULL) */
+				break;
+			engine->free(trace->blocks[index]);
+			trace->blocks[index] = NULL;
+			break;
+		}
+		if (access)
+			access_step(trace, i);
+	}
+}
+
+/**********************************************************************
+ * Multi-threaded replay. Each of k threads replays its own copy of the
+ * trace, or with -P only the ids i with i % k equal to its number.
+ * With -X, a share of the frees is handed to the next thread's free
+ * queue instead, and that thread frees the block. Allocators that are
+ * not thread-safe run under one global lock; thread-safe engines run
+ * both without and with it, the latter as a baseline.
+ **********************************************************************/
+
+/* An allocator under test */
+typedef struct
+{
+	char name[32];
+	int (*init)(void);
+	void *(*malloc)(uint32_t size);
+	void (*free)(void *ptr);
+	void *(*realloc)(void *ptr, uint32_t size);
+	int locked; /* serialize every call with mt_lock */
+} mt_alloc_t;
+
+/* Blocks that another thread asked this one to free */
+typedef struct
+{
+	pthread_mutex_t lock;
+	void **items; /* room for every free in the trace */
+	int count;
+} mt_queue_t;
+
+/* One replay thread */
+typedef struct mt_thread
+{
+	int id;
+	int nthreads;
+	struct mt_thread *all; /* every thread, to reach their queues */
+	trace_t *trace;
+	const mt_alloc_t *alloc;
+	char **blocks; /* this thread's block pointers, by id */
+	void **drained; /* scratch space for emptying the queue */
+	mt_queue_t queue;
+	long ops;	 /* requests this thread made */
+	double secs; /* time it took to make them */
+	double begin, end; /* when it started and finished, drain included */
+	pthread_t tid;
+} mt_thread_t;
+
+/* Results for one allocator at one thread count */
+typedef struct
+{
+	double ops;		  /* requests made by all threads */
+	double wall;	  /* elapsed time of the parallel replay */
+	double busy;	  /* sum of per-thread times */
+	double worst_lat; /* slowest thread's secs per request */
+} mt_stats_t;
+
+static pthread_mutex_t mt_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_barrier_t mt_start, mt_done;
+
+static double mt_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *mt_malloc(const mt_alloc_t *alloc, uint32_t size)
+{
+	void *p;
+
+	if (!alloc->locked)
+		return alloc->malloc(size);
+	pthread_mutex_lock(&mt_lock);
+	p = alloc->malloc(size);
+	pthread_mutex_unlock(&mt_lock);
+	return p;
+}
+
+static void *mt_realloc(const mt_alloc_t *alloc, void *ptr, uint32_t size)
+{
+	void *p;
+
+	if (!alloc->locked)
+		return alloc->realloc(ptr, size);
+	pthread_mutex_lock(&mt_lock);
+	p = alloc->realloc(ptr, size);
+	pthread_mutex_unlock(&mt_lock);
+	return p;
+}
+
+static void mt_free(const mt_alloc_t *alloc, void *ptr)
+{
+	if (!alloc->locked)
+	{
+		alloc->free(ptr);
+		return;
+	}
+	pthread_mutex_lock(&mt_lock);
+	alloc->free(ptr);
+	pthread_mutex_unlock(&mt_lock);
+}
+
+/*
+ * mt_drain - free the blocks other threads handed to thread t
+ */
+static void mt_drain(mt_thread_t *t)
+{
+	int i, n;
+
+	pthread_mutex_lock(&t->queue.lock);
+	n = t->queue.count;
+	memcpy(t->drained, t->queue.items, n * sizeof(void *));
+	t->queue.count = 0;
+	pthread_mutex_unlock(&t->queue.lock);
+
+	for (i = 0; i < n; i++)
+		mt_free(t->alloc, t->drained[i]);
+}
+
+/*
+ * mt_handoff - hand block p to the next thread's free queue
+ */
+static void mt_handoff(mt_thread_t *t, void *p)
+{
+	mt_queue_t *q = &t->all[(t->id + 1) % t->nthreads].queue;
+
+	pthread_mutex_lock(&q->lock);
+	q->items[q->count++] = p;
+	pthread_mutex_unlock(&q->lock);
+}
+
+/*
+ * mt_replay - body of a replay thread
+ */
+static void *mt_replay(void *arg)
+{
+	mt_thread_t *t = (mt_thread_t *)arg;
+	trace_t *trace = t->trace;
+	int xfree = xfree_percent > 0 && t->nthreads > 1;
+	int i, index, owner;
+	double start, drain;
+	long ops = 0;
+	char *p;
+
+	pthread_barrier_wait(&mt_start);
+	start = t->begin = mt_now();
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		owner = (index < 0) ? 0 : index % t->nthreads;
+		if (partition_ids && owner != t->id)
+			continue;
+
+		switch (trace->ops[i].type)
+		{
+		case ALLOC:
+			if ((p = mt_malloc(t->alloc, trace->ops[i].size)) == NULL)
+				app_error("malloc failed in multi-threaded replay");
+			t->blocks[index] = p;
+			break;
+
+		case REALLOC:
+			if ((p = mt_realloc(t->alloc, t->blocks[index],
+								trace->ops[i].size)) == NULL)
+				app_error("realloc failed in multi-threaded replay");
+			t->blocks[index] = p;
+			break;
+
+		case FREE:
+			if (index < 0) /* free(NULL) */
+				break;
+			p = t->blocks[index];
+			t->blocks[index] = NULL;
+			/* The same frees go across on every run */
+			if (xfree && ((unsigned)i * 2654435761u) % 100 < (unsigned)xfree_percent)
+				mt_handoff(t, p);
+			else
+				mt_free(t->alloc, p);
+			break;
+		}
+		if (xfree && (++ops & 63) == 0)
+			mt_drain(t);
+		else if (!xfree)
+			ops++;
+	}
+	t->secs = mt_now() - start;
+
+	/* Nothing more is handed to us once every thread is done */
+	pthread_barrier_wait(&mt_done);
+	drain = mt_now();
+	mt_drain(t);
+	t->end = mt_now();
+	t->secs += t->end - drain;
+	t->ops = ops;
+	return NULL;
+}
+
+/*
+ * mt_run - replay trace with nthreads threads and add the results to st
+ */
+static void mt_run(const mt_alloc_t *alloc, trace_t *trace, int nthreads,
+				   mt_stats_t *st)
+{
+	mt_thread_t *threads;
+	double first, last;
+	int i, j;
+
+	if (alloc->init() < 0)
+		app_error("init failed in multi-threaded replay");
+	if ((threads = (mt_thread_t *)calloc(nthreads, sizeof(mt_thread_t))) == NULL)
+		unix_error("calloc failed in mt_run");
+	pthread_barrier_init(&mt_start, NULL, nthreads);
+	pthread_barrier_init(&mt_done, NULL, nthreads);
+
+	for (i = 0; i < nthreads; i++)
+	{
+		mt_thread_t *t = &threads[i];
+
+		t->id = i;
+		t->nthreads = nthreads;
+		t->all = threads;
+		t->trace = trace;
+		t->alloc = alloc;
+		t->blocks = (char **)calloc(trace->num_ids, sizeof(char *));
+		t->drained = (void **)malloc(trace->num_ops * sizeof(void *));
+		t->queue.items = (void **)malloc(trace->num_ops * sizeof(void *));
+		if (t->blocks == NULL || t->drained == NULL || t->queue.items == NULL)
+			unix_error("malloc failed in mt_run");
+		pthread_mutex_init(&t->queue.lock, NULL);
+	}
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[i].tid, NULL, mt_replay, &threads[i]) != 0)
+			unix_error("pthread_create failed in mt_run");
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i].tid, NULL);
+
+	/* The replay runs from the first thread's start to the last one's
+	   finish, whenever this thread happened to be scheduled */
+	first = threads[0].begin;
+	last = threads[0].end;
+	for (i = 1; i < nthreads; i++)
+	{
+		if (threads[i].begin < first)
+			first = threads[i].begin;
+		if (threads[i].end > last)
+			last = threads[i].end;
+	}
+	st->wall += last - first;
+	for (i = 0; i < nthreads; i++)
+	{
+		mt_thread_t *t = &threads[i];
+
+		st->ops += t->ops;
+		st->busy += t->secs;
+		if (t->ops > 0 && t->secs / t->ops > st->worst_lat)
+			st->worst_lat = t->secs / t->ops;
+
+		/* Free what the trace left allocated, for engines that cannot
+		   reset their heap */
+		for (j = 0; j < trace->num_ids; j++)
+			if (t->blocks[j] != NULL)
+				mt_free(alloc, t->blocks[j]);
+		pthread_mutex_destroy(&t->queue.lock);
+		free(t->blocks);
+		free(t->drained);
+		free(t->queue.items);
+	}
+	pthread_barrier_destroy(&mt_start);
+	pthread_barrier_destroy(&mt_done);
+	free(threads);
+}
+
+static int mt_mm_init(void)
+{
+	mem_reset_brk();
+	return mm_init();
+}
+
+static void mt_printstats(const char *name, int nthreads, mt_stats_t *st)
+{
+	printf("%-20.20s%8d%10.0f%12.0f%12.0f\n", name, nthreads,
+		   st->ops / 1e3 / st->wall, st->busy / st->ops * 1e9,
+		   st->worst_lat * 1e9);
+}
+
+/*
+ * eval_mt - replay every trace with 1..max_threads threads on each
+ *     allocator and print aggregate throughput and per-thread latency
+ */
+static void eval_mt(int n, char **tracefiles)
+{
+	mt_alloc_t allocs[2 * MAXENGINES + 1];
+	int nallocs = 0;
+	int a, k, i;
+
+	snprintf(allocs[nallocs].name, sizeof(allocs[0].name), "built-in+lock");
+	allocs[nallocs].init = mt_mm_init;
+	allocs[nallocs].malloc = mm_malloc;
+	allocs[nallocs].free = mm_free;
+	allocs[nallocs].realloc = mm_realloc;
+	allocs[nallocs++].locked = 1;
+	for (i = 0; i < num_engines; i++)
+	{
+		int safe = (engines[i]->flags & MM_ENGINE_THREADSAFE) != 0;
+
+		/* A thread-safe engine runs both alone and under the lock */
+		for (k = safe ? 0 : 1; k < 2; k++)
+		{
+			snprintf(allocs[nallocs].name, sizeof(allocs[0].name), "%s%s",
+					 engines[i]->name, k ? "+lock" : "");
+			allocs[nallocs].init = engines[i]->init;
+			allocs[nallocs].malloc = engines[i]->malloc;
+			allocs[nallocs].free = engines[i]->free;
+			allocs[nallocs].realloc = engines[i]->realloc;
+			allocs[nallocs++].locked = k;
+		}
+	}
+
+	printf("\nMulti-threaded replay: %s, %d%% of frees cross-thread\n",
+		   partition_ids ? "ids partitioned among threads"
+						 : "each thread replays its own copy",
+		   xfree_percent);
+	printf("%-20s%8s%10s%12s%12s\n", "allocator", "threads", "Kops",
+		   "ns/op avg", "ns/op max");
+
+	for (a = 0; a < nallocs; a++)
+	{
+		for (k = 1; k <= max_threads; k++)
+		{
+			mt_stats_t total = {0, 0, 0, 0};
+
+			for (i = 0; i < n; i++)
+			{
+				trace_t *trace = read_trace(tracedir, tracefiles[i]);
+				mt_stats_t st = {0, 0, 0, 0};
+
+				mt_run(&allocs[a], trace, k, &st);
+				if (verbose)
+					mt_printstats(tracefiles[i], k, &st);
+				total.ops += st.ops;
+				total.wall += st.wall;
+				total.busy += st.busy;
+				if (st.worst_lat > total.worst_lat)
+					total.worst_lat = st.worst_lat;
+				free_trace(trace);
+			}
+			mt_printstats(allocs[a].name, k, &total);
+		}
+	}
+	printf("\n");
+}
+
+/**********************************************************************
+ * Soak mode. The traces are replayed in rotation, -S times in all, on
+ * one heap that is initialized only once. Whatever a trace leaves
+ * allocated is freed after it, but the heap is never reset, so
+ * fragmentation and slowdowns that build up over many runs show up as
+ * drift in the heap size, utilization and throughput of the later
+ * iterations.
+ **********************************************************************/
+
+/* Results of one soak iteration */
+typedef struct
+{
+	double ops;	 /* requests in the trace */
+	double secs; /* time to replay them */
+	double peak; /* peak live payload bytes */
+	size_t heap; /* heap size after the iteration */
+} soak_stats_t;
+
+/*
+ * soak_replay - Replay trace on the current heap and then free what it
+ *     left allocated. Returns 0 if the allocator ran out of memory.
+ */
+static int soak_replay(trace_t *trace, soak_stats_t *st)
+{
+	double live = 0, start;
+	int i, index;
+	char *p;
+
+	clear_blocks(trace);
+	st->peak = 0;
+	start = mt_now();
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		switch (trace->ops[i].type)
+		{
+		case ALLOC:
+			if ((p = trace_malloc(trace, index, trace->ops[i].size)) == NULL)
+				return 0;
+			break;
+
+		case REALLOC:
+			if ((p = trace_realloc(trace, index, trace->blocks[index],
+								  trace->ops[i].size)) == NULL)
+				return 0;
+			live -= trace->block_sizes[index];
+			break;
+
+		case FREE:
+			if (index < 0) /* free(NULL) */
+				continue;
+			mm_free(trace->blocks[index]);
+			live -= trace->block_sizes[index];
+			trace->blocks[index] = NULL;
+			trace->block_sizes[index] = 0;
+			continue;
+
+		default:
+			app_error("Nonexistent request type in soak_replay");
+		}
+		trace->blocks[index] = p;
+		trace->block_sizes[index] = trace->ops[i].size;
+		live += trace->ops[i].size;
+		if (live > st->peak)
+			st->peak = live;
+	}
+	st->secs = mt_now() - start;
+	st->ops = trace->num_ops;
+
+	/* The leftovers are freed outside the timed replay */
+	for (i = 0; i < trace->num_ids; i++)
+		if (trace->blocks[i] != NULL)
+			mm_free(trace->blocks[i]);
+	st->heap = mem_heapsize();
+	return 1;
+}
+
+/*
+ * soak_round - Sum of the stats of iterations from..to-1; utilization
+ *     is the mean over the iterations
+ */
+static void soak_round(soak_stats_t *st, int from, int to, double *util,
+					   double *kops, size_t *heap)
+{
+	double ops = 0, secs = 0;
+	int i;
+
+	*util = 0;
+	for (i = from; i < to; i++)
+	{
+		ops += st[i].ops;
+		secs += st[i].secs;
+		*util += st[i].peak / st[i].heap;
+	}
+	*util /= to - from;
+	*kops = ops / 1e3 / secs;
+	*heap = st[to - 1].heap;
+}
+
+/*
+ * eval_soak - replay the traces in rotation soak_iterations times on a
+ *     heap that is never reset, printing the heap size, utilization and
+ *     throughput of each iteration, then the drift from the first round
+ *     of traces to the last
+ */
+static void eval_soak(int n, char **tracefiles)
+{
+	trace_t **traces;
+	soak_stats_t *st;
+	double util0, util1, kops0, kops1;
+	size_t heap0, heap1;
+	int i, done;
+
+	traces = (trace_t **)malloc(n * sizeof(trace_t *));
+	st = (soak_stats_t *)malloc(soak_iterations * sizeof(soak_stats_t));
+	if (traces == NULL || st == NULL)
+		unix_error("malloc failed in eval_soak");
+	for (i = 0; i < n; i++)
+		traces[i] = read_trace(tracedir, tracefiles[i]);
+
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_soak");
+
+	printf("\nSoak: %d iterations over %d trace%s without a heap reset\n",
+		   soak_iterations, n, n == 1 ? "" : "s");
+	printf("%10s  %-20s%12s%6s%10s\n", "iteration", "trace", "heap KB",
+		   "util", "Kops");
+	for (done = 0; done < soak_iterations; done++)
+	{
+		if (!soak_replay(traces[done % n], &st[done]))
+		{
+			printf("%10d  %-20.20s out of memory with a %zu KB heap\n",
+				   done + 1, tracefiles[done % n], mem_heapsize() / 1024);
+			break;
+		}
+		printf("%10d  %-20.20s%12zu%5.0f%%%10.0f\n", done + 1,
+			   tracefiles[done % n], st[done].heap / 1024,
+			   100 * st[done].peak / st[done].heap,
+			   st[done].ops / 1e3 / st[done].secs);
+		fflush(stdout);
+
+		/* Heap checks (-c or -C) between iterations */
+		if ((sample_check_interval || full_check_interval) &&
+			mm_checkheap(MM_CHECK_LISTS) < 0)
+		{
+			printf("mm_checkheap failed after iteration %d\n", done + 1);
+			break;
+		}
+	}
+
+	/* Drift: the first full round of traces against the last one */
+	if (done >= 2 * n)
+	{
+		soak_round(st, 0, n, &util0, &kops0, &heap0);
+		soak_round(st, done - n, done, &util1, &kops1, &heap1);
+		printf("Drift from the first round to the last: heap %zu -> %zu KB, "
+			   "util %.0f%% -> %.0f%%, Kops %.0f -> %.0f\n",
+			   heap0 / 1024, heap1 / 1024, 100 * util0, 100 * util1,
+			   kops0, kops1);
+	}
+	printf("\n");
+
+	for (i = 0; i < n; i++)
+		free_trace(traces[i]);
+	free(traces);
+	free(st);
+}
+
+/*************************************
+ * Some miscellaneous helper routines
+ ************************************/
+
+/*
+ * printresults - prints a performance summary for some malloc package
+ */
+static void printresults(int n, stats_t *stats)
+{
+	int i;
+	double secs = 0;
+	double ops = 0;
+	double util = 0;
+	double weights = 0;
+
+	/* Print the individual results for each trace (the totals weigh
+	   each trace by its weight in the suite) */
+	printf("%5s%7s %5s%8s%10s%6s\n",
+		   "trace", " valid", "util", "ops", "secs", "Kops");
+	for (i = 0; i < n; i++)
+	{
+		if (stats[i].valid)
+		{
+			printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n",
+				   i,
 				   "yes",
 				   stats[i].util * 100.0,
 				   stats[i].ops,
 				   stats[i].secs,
 				   (stats[i].ops / 1e3) / stats[i].secs);
-			secs += stats[i].secs;
-			ops += stats[i].ops;
-			util += stats[i].util;
+			secs += trace_weights[i] * stats[i].secs;
+			ops += trace_weights[i] * stats[i].ops;
+			util += trace_weights[i] * stats[i].util;
+			weights += trace_weights[i];
 		}
 		else
 		{
@@ -1029,7 +2579,7 @@ static void printresults(int n, stats_t *stats)
 	{
 		printf("%12s%5.0f%%%8.0f%10.6f%6.0f\n",
 			   "Total       ",
-			   (util / n) * 100.0,
+			   (util / weights) * 100.0,
 			   ops,
 			   secs,
 			   (ops / 1e3) / secs);
@@ -1045,6 +2595,175 @@ static void printresults(int n, stats_t *stats)
 	}
 }
 
+/*
+ * printcompare - prints the built-in mm package, libc (if run) and
+ *     each -e engine side by side, one column of util and Kops each
+ */
+static int compare_columns(stats_t **cols, const char **names, int *has_util,
+						   stats_t *mm_stats, stats_t *libc_stats,
+						   stats_t **engine_stats)
+{
+	int ncols = 0;
+	int i;
+
+	cols[ncols] = mm_stats;
+	names[ncols] = "built-in";
+	has_util[ncols++] = 1;
+	if (libc_stats != NULL)
+	{
+		cols[ncols] = libc_stats;
+		names[ncols] = "libc -l";
+		has_util[ncols++] = 0;
+	}
+	for (i = 0; i < num_engines; i++)
+	{
+		cols[ncols] = engine_stats[i];
+		names[ncols] = engines[i]->name;
+		has_util[ncols++] = engines[i]->heapsize != NULL;
+	}
+	return ncols;
+}
+
+static void printcompare(int n, char **tracefiles, stats_t *mm_stats,
+						 stats_t *libc_stats, stats_t **engine_stats)
+{
+	stats_t *cols[MAXENGINES + 2];
+	const char *names[MAXENGINES + 2];
+	int has_util[MAXENGINES + 2];
+	int ncols = compare_columns(cols, names, has_util, mm_stats, libc_stats,
+								engine_stats);
+	int i, c;
+
+	printf("\nEngine comparison:\n%-20s", "");
+	for (c = 0; c < ncols; c++)
+		printf("%15.15s", names[c]);
+	printf("\n%-20s", "trace");
+	for (c = 0; c < ncols; c++)
+		printf("%7s%8s", "util", "Kops");
+	printf("\n");
+
+	for (i = 0; i <= n; i++)
+	{
+		printf("%-20.20s", i < n ? tracefiles[i] : "Total");
+		for (c = 0; c < ncols; c++)
+		{
+			double util = 0, ops = 0, secs = 0, weights = 0;
+			int j, valid = 1;
+
+			/* The Total row weighs each trace by its weight in the
+			   suite, as printresults does */
+			for (j = (i < n ? i : 0); j < (i < n ? i + 1 : n); j++)
+			{
+				valid = valid && cols[c][j].valid;
+				util += trace_weights[j] * cols[c][j].util;
+				ops += trace_weights[j] * cols[c][j].ops;
+				secs += trace_weights[j] * cols[c][j].secs;
+				weights += trace_weights[j];
+			}
+			if (!valid)
+				printf("%7s%8s", "-", "-");
+			else if (!has_util[c])
+				printf("%7s%8.0f", "-", ops / 1e3 / secs);
+			else
+				printf("%6.0f%%%8.0f", util * 100.0 / weights,
+					   ops / 1e3 / secs);
+		}
+		printf("\n");
+	}
+}
+
+/*
+ * printaccess - prints, for the built-in package, libc (if run) and
+ *     each -e engine, the throughput without and with the -A access
+ *     model and how much slower the accesses made the replay
+ */
+static void printaccess(int n, char **tracefiles, stats_t *mm_stats,
+						stats_t *libc_stats, stats_t **engine_stats)
+{
+	stats_t *cols[MAXENGINES + 2];
+	const char *names[MAXENGINES + 2];
+	int has_util[MAXENGINES + 2];
+	int ncols = compare_columns(cols, names, has_util, mm_stats, libc_stats,
+								engine_stats);
+	int i, c;
+
+	printf("\nAccess model: %s live blocks, %d every %d requests:\n%-20s",
+		   access_model == ACCESS_RECENT ? "recent" : "random", access_count,
+		   access_period, "");
+	for (c = 0; c < ncols; c++)
+		printf("%22.22s", names[c]);
+	printf("\n%-20s", "trace");
+	for (c = 0; c < ncols; c++)
+		printf("%8s%8s%6s", "Kops", "+access", "slow");
+	printf("\n");
+
+	for (i = 0; i <= n; i++)
+	{
+		printf("%-20.20s", i < n ? tracefiles[i] : "Total");
+		for (c = 0; c < ncols; c++)
+		{
+			double ops = 0, secs = 0, access_secs = 0;
+			int j, valid = 1;
+
+			for (j = (i < n ? i : 0); j < (i < n ? i + 1 : n); j++)
+			{
+				valid = valid && cols[c][j].valid;
+				ops += trace_weights[j] * cols[c][j].ops;
+				secs += trace_weights[j] * cols[c][j].secs;
+				access_secs += trace_weights[j] * cols[c][j].access_secs;
+			}
+			if (!valid)
+				printf("%8s%8s%6s", "-", "-", "-");
+			else
+				printf("%8.0f%8.0f%5.0f%%", ops / 1e3 / secs,
+					   ops / 1e3 / access_secs,
+					   100.0 * (access_secs - secs) / secs);
+		}
+		printf("\n");
+	}
+}
+
+/*
+ * write_json - write the mm results for each trace and overall to path
+ *     as a JSON object, for scripts such as grade-malloc.py
+ */
+static void write_json(const char *path, int n, char **tracefiles,
+					   stats_t *stats, double util, double kops,
+					   double perfindex, int numcorrect)
+{
+	FILE *f;
+	int i;
+
+	if ((f = fopen(path, "w")) == NULL)
+	{
+		snprintf(msg, MAXLINE, "Could not open %.1024s in write_json", path);
+		unix_error(msg);
+	}
+	fprintf(f, "{\n  \"traces\": [\n");
+	for (i = 0; i < n; i++)
+	{
+		const char *c;
+
+		/* Trace names are paths; only quotes and backslashes need escapes */
+		fprintf(f, "    {\"name\": \"");
+		for (c = tracefiles[i]; *c != '\0'; c++)
+			fprintf(f, (*c == '"' || *c == '\\') ? "\\%c" : "%c", *c);
+		fprintf(f, "\", \"weight\": %g, \"valid\": %s", trace_weights[i],
+				stats[i].valid ? "true" : "false");
+		if (stats[i].valid)
+			fprintf(f, ", \"util\": %.6f, \"ops\": %.0f, \"secs\": %.9f, "
+					   "\"kops\": %.3f",
+					stats[i].util, stats[i].ops, stats[i].secs,
+					stats[i].ops / 1e3 / stats[i].secs);
+		fprintf(f, "}%s\n", i < n - 1 ? "," : "");
+	}
+	fprintf(f, "  ],\n  \"errors\": %d,\n  \"correct\": %d,\n", errors,
+			numcorrect);
+	fprintf(f, "  \"util\": %.6f,\n  \"kops\": %.3f,\n  \"perfidx\": %.3f\n}\n",
+			util, kops, perfindex);
+	fclose(f);
+}
+
 /* 
  * app_error - Report an arbitrary application error
  */
@@ -1077,14 +2796,30 @@ void malloc_error(int tracenum, int opnum, const char *msg)
  */
 static void usage(void)
 {
-	fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+	fprintf(stderr, "Usage: mdriver [-hvValHFi] [-f <file> | -s <suite>] [-t <dir>] [-c <n>] [-C <n>]\n");
+	fprintf(stderr, "               [-A recent|random[:<period>[:<count>]]] [-K <k>] [-J <file>]\n");
+	fprintf(stderr, "               [-e <engine.so>]... [-T <n> [-P] [-X <pct>]] [-S <n>]\n");
 	fprintf(stderr, "Options\n");
 	fprintf(stderr, "\t-a         Don't check the team structure.\n");
+	fprintf(stderr, "\t-A <model> Also time replays that touch payloads.\n");
+	fprintf(stderr, "\t-c <n>     Sampled mm_checkheap every <n> ops.\n");
+	fprintf(stderr, "\t-C <n>     Full mm_checkheap every <n> ops.\n");
+	fprintf(stderr, "\t-e <so>    Also run the allocator engine in <so>.\n");
 	fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+	fprintf(stderr, "\t-F         Measure utilization in the validation pass.\n");
 	fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
 	fprintf(stderr, "\t-h         Print this message.\n");
+	fprintf(stderr, "\t-H         Use the lifetime hints in <trace>.hints.\n");
+	fprintf(stderr, "\t-K <k>     Fully check the data of every <k>th realloc only.\n");
+	fprintf(stderr, "\t-i         Run the timed replays in a child process.\n");
+	fprintf(stderr, "\t-J <file>  Also write the results to <file> as JSON.\n");
 	fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+	fprintf(stderr, "\t-P         With -T, partition the ids among the threads.\n");
+	fprintf(stderr, "\t-s <name>  Use the traces of suite <name> in the manifest.\n");
+	fprintf(stderr, "\t-S <n>     Also replay the traces <n> times on one heap.\n");
 	fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+	fprintf(stderr, "\t-T <n>     Also replay with 1..<n> threads.\n");
 	fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
 	fprintf(stderr, "\t-V         Print additional debug info.\n");
+	fprintf(stderr, "\t-X <pct>   With -T, free <pct>%% of blocks in another thread.\n");
 }
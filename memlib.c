@@ -18,17 +18,33 @@
 char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static int mem_quiet;        /* report mem_sbrk failures through errno only */
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
+#ifdef MEMLIB_MMAP
+    /* 
+     * Reserve the storage with mmap instead of malloc, so that memlib
+     * can back an allocator that replaces malloc itself. Pages are only
+     * committed when the heap grows into them.
+     */
+    mem_start_brk = (char *)mmap(NULL, MAX_HEAP, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+				 -1, 0);
+    if (mem_start_brk == (char *)MAP_FAILED) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
+	exit(1);
+    }
+#else
     /* allocate the storage we will use to model the available VM */
     if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
 	fprintf(stderr, "mem_init_vm: malloc error\n");
 	exit(1);
     }
+#endif
 
     mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
@@ -39,7 +55,11 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
+#ifdef MEMLIB_MMAP
+    munmap(mem_start_brk, MAX_HEAP);
+#else
     free(mem_start_brk);
+#endif
 }
 
 /*
@@ -61,7 +81,8 @@ void *mem_sbrk(int incr)
 
     if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
 	errno = ENOMEM;
-	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
+	if (!mem_quiet)
+	    fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
     mem_brk += incr;
@@ -99,3 +120,12 @@ size_t mem_pagesize()
 {
     return (size_t)getpagesize();
 }
+
+/*
+ * mem_set_quiet - with quiet set, a failing mem_sbrk only sets errno,
+ *    for callers that make requests the heap is expected to refuse
+ */
+void mem_set_quiet(int quiet)
+{
+    mem_quiet = quiet;
+}
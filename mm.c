@@ -6,11 +6,19 @@
  * 
  *      31                     3  2  1  0 
  *      -----------------------------------
- *     | s  s  s  s  ... s  s  s  0  0  a/f
+ *     | s  s  s  s  ... s  s  s  c  c  a/f
  *      ----------------------------------- 
  * 
- * where s are the meaningful size bits and a/f is set 
- * iff the block is allocated. The list has the following form:
+ * where s are the meaningful size bits, a/f is set iff the block is
+ * allocated, and c is the lifetime class (MM_HINT_*) of the block.
+ * Each class grows its own set of heap chunks: a block of class c is
+ * carved from a chunk that was added to the heap for class c, free
+ * blocks are kept on one free list per class, and free neighbours
+ * only coalesce when their classes match. Blocks allocated with
+ * mm_malloc_hint() are thus placed among blocks of the same expected
+ * lifetime. A class takes a free block from another class's list only
+ * when the heap cannot grow, and the block then keeps the class of
+ * the chunk it came from. The heap has the following form:
  *
  * begin                                                          end
  * heap                                                           heap  
@@ -29,6 +37,7 @@
 #include <memory.h>
 #include "mm.h"
 #include "memlib.h"
+#include "mm_sizeclasses.h"
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -57,13 +66,58 @@ team_t team = {
 /////////////////////////////////////////////////////////////////////////////
 #define WSIZE       4       /* word size (bytes) */  
 #define DSIZE       8       /* doubleword size (bytes) */
-#define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
 #define OVERHEAD    8       /* overhead of header and footer (bytes) */
+#define MINBLOCK    24      /* hdr + prev/next links + ftr */
+#define MAX_REQUEST (UINT32_MAX - 2*DSIZE) /* larger sizes overflow asize */
 
-static inline int MAX(int x, int y) {
+//
+// Tuning knobs, which autotune.py overrides with -D
+//
+#ifndef CHUNKSIZE
+#define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
+#endif
+#ifndef SPLIT_THRESHOLD
+#define SPLIT_THRESHOLD MINBLOCK /* smallest remainder place splits off */
+#endif
+#if SPLIT_THRESHOLD < MINBLOCK
+#error "SPLIT_THRESHOLD must be at least MINBLOCK"
+#endif
+
+#define BEST_FIT    0       /* smallest free block that fits */
+#define FIRST_FIT   1       /* first free block that fits */
+#ifndef FIT_POLICY
+#define FIT_POLICY  BEST_FIT
+#endif
+
+//
+// FIT_INDEX=1 makes list_fit scan a struct-of-arrays index of the free
+// block sizes with SIMD compares instead of walking the free list
+//
+#ifndef FIT_INDEX
+#define FIT_INDEX   0
+#endif
+#ifndef FIT_INDEX_MAX
+#define FIT_INDEX_MAX (1<<14) /* free blocks per class the index holds */
+#endif
+#define FIT_INDEX_SIMD 32   /* shorter indexes are scanned without SIMD */
+
+static inline uint32_t MAX(uint32_t x, uint32_t y) {
   return x > y ? x : y;
 }
 
+//
+// Round a request up to its size class from mm_sizeclasses.h, if any
+//
+static inline uint32_t SIZE_CLASS(uint32_t size) {
+  int i;
+
+  for(i = 0; mm_sizeclasses[i].size != 0 && size > mm_sizeclasses[i].hi; i++)
+    ;
+  if(mm_sizeclasses[i].size != 0 && size >= mm_sizeclasses[i].lo)
+    return mm_sizeclasses[i].size;
+  return size;
+}
+
 //
 // Pack a size and allocated bit into a word
 // We mask of the "alloc" field to insure only
@@ -73,6 +127,13 @@ static inline uint32_t PACK(uint32_t size, int alloc) {
   return ((size) | (alloc & 0x1));
 }
 
+//
+// Pack a size, allocated bit and lifetime class into a word
+//
+static inline uint32_t PACK_CLASS(uint32_t size, int alloc, int cls) {
+  return PACK(size, alloc) | ((cls & 0x3) << 1);
+}
+
 //
 // Read and write a word at address p
 //
@@ -93,6 +154,10 @@ static inline int GET_ALLOC( void *p  ) {
   return GET(p) & 0x1;
 }
 
+static inline int GET_CLASS( void *p ) {
+  return (GET(p) >> 1) & 0x3;
+}
+
 //
 // Given block ptr bp, compute address of its header and footer
 //
@@ -127,27 +192,82 @@ typedef struct linkedlist
     struct linkedlist *next;
 }linkedlist;
 
-static linkedlist *firstlist;
+#define NUM_CLASSES 3       /* MM_HINT_UNKNOWN, MM_HINT_SHORT, MM_HINT_LONG */
+
+static linkedlist *firstlist[NUM_CLASSES];
 static char *heap_listp;
 
+#if FIT_INDEX
+// Size and offset from heap_listp of every block larger than MINBLOCK
+// on one free list, in no particular order
+typedef struct fitindex
+{
+    uint32_t size[FIT_INDEX_MAX];
+    uint32_t offset[FIT_INDEX_MAX];
+    uint32_t count;
+    uint32_t small;     /* MINBLOCK blocks on the list, not indexed */
+    int overflow;       /* list outgrew the index; walk the list instead */
+}fitindex;
+
+// An indexed block's slot, after its free list links
+static inline uint32_t *SLOTP(void *bp) {
+  return (uint32_t *)((char *)bp + sizeof(linkedlist));
+}
+
+static fitindex fit_index[NUM_CLASSES];
+#endif
+
+// Block touched by the most recent operation; the sampled heap
+// check starts its walk from here
+static void *last_bp;
+
 //
 // function prototypes for internal helper routines
 //
-static void *extend_heap(uint32_t words);
-static void place(void *bp, uint32_t asize);
-static void *find_fit(uint32_t asize);
+static void *extend_heap(uint32_t words, int cls);
+static void *allocate(uint32_t size, int cls);
+static void *place(void *bp, uint32_t asize);
+static void *find_fit(uint32_t asize, int cls);
+static void *list_fit(int cls, uint32_t asize);
 static void *coalesce(void *bp);
+static void trim(void *bp, uint32_t asize);
 
 // free list control
 static void listInsert(linkedlist *bp);
 static void listRemove(linkedlist* bp);
 
+// free-size index, kept in step with the free lists
+#if FIT_INDEX
+static void indexInit(void);
+static void indexInsert(void *bp);
+static void indexRemove(void *bp);
+static void indexResize(void *bp, uint32_t oldsize);
+static void *indexFit(fitindex *ix, uint32_t asize);
+static int checkIndex(void);
+#else
+static inline void indexInit(void) {}
+static inline void indexInsert(void *bp) {}
+static inline void indexRemove(void *bp) {}
+static inline void indexResize(void *bp, uint32_t oldsize) {}
+#endif
+
+// heap checker
+static int checkBlock(void *bp);
+static int checkLinks(linkedlist *bp);
+static int checkBoundaries(void);
+static int checkWindow(void);
+
 //
 // mm_init - Initialize the memory manager 
 //
 int mm_init(void)
 {
-    firstlist = NULL;
+    int i;
+
+    for(i = 0; i < NUM_CLASSES; i++)
+        firstlist[i] = NULL;
+    last_bp = NULL;
+    indexInit();
 
     if((heap_listp = mem_sbrk(4*WSIZE)) == (void*) -1)
         return -1;
@@ -158,16 +278,17 @@ int mm_init(void)
     PUT(heap_listp + (3*WSIZE), PACK(0,1));
     heap_listp += (2*WSIZE);
     
-    if(extend_heap(CHUNKSIZE/WSIZE) == NULL)
+    if(extend_heap(CHUNKSIZE/WSIZE, MM_HINT_UNKNOWN) == NULL)
         return -1;
     
     return 0;
 }
 
 //
-// extend_heap - Extend heap with free block and return its block pointer
+// extend_heap - Extend heap with a free block of class cls and
+//               return its block pointer
 //
-static void *extend_heap(uint32_t words) 
+static void *extend_heap(uint32_t words, int cls)
 {
     void *bp;
     uint32_t size;
@@ -175,8 +296,8 @@ static void *extend_heap(uint32_t words)
     if((bp = mem_sbrk(size)) == (void*) -1)
         return NULL;
     
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size, 0));
+    PUT(HDRP(bp), PACK_CLASS(size, 0, cls));
+    PUT(FTRP(bp), PACK_CLASS(size, 0, cls));
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0,1));
 
     return coalesce(bp);
@@ -185,16 +306,63 @@ static void *extend_heap(uint32_t words)
 //
 // Practice problem 9.8
 //
-// find_fit - Find a fit for a block with asize bytes 
+// find_fit - Find a free block of at least asize bytes for lifetime
+//            class cls: on the class's own list, else in a new chunk
+//            of the class, else on another class's list
+//
+static void *find_fit(uint32_t asize, int cls)
+{
+    void *bp;
+    void *last = PREV_BLKP((char *)mem_heap_hi() + 1);
+    uint32_t need = asize;
+    int i;
+
+    if((bp = list_fit(cls, asize)) != NULL)
+    {
+        return bp;
+    }
+    // A free block of the class at the end of the heap merges with
+    // the new chunk, so the chunk only has to make up the difference
+    if(!GET_ALLOC(HDRP(last)) && GET_CLASS(HDRP(last)) == cls)
+    {
+        need -= GET_SIZE(HDRP(last));
+    }
+    if((bp = extend_heap(MAX(need, CHUNKSIZE)/WSIZE, cls)) != NULL)
+    {
+        return bp;
+    }
+    for(i = 0; i < NUM_CLASSES; i++)
+    {
+        if(i != cls && (bp = list_fit(i, asize)) != NULL)
+        {
+            return bp;
+        }
+    }
+    return NULL;
+}
+
+//
+// list_fit - Block on free list cls with at least asize bytes, chosen
+//            by FIT_POLICY
 //
-static void *find_fit(uint32_t asize)
+static void *list_fit(int cls, uint32_t asize)
 {
     linkedlist* bp;
     linkedlist* best = NULL;
     uint32_t best_size = 2147483648;
-    for(bp = firstlist; bp != NULL; bp = bp->next)
+
+#if FIT_INDEX
+    // Only the list holds MINBLOCK blocks
+    if(!fit_index[cls].overflow &&
+       (asize > MINBLOCK || fit_index[cls].small == 0))
+    {
+        return indexFit(&fit_index[cls], asize);
+    }
+#endif
+    for(bp = firstlist[cls]; bp != NULL; bp = bp->next)
     {
-        if(GET_SIZE(HDRP(bp)) == asize)
+        if(GET_SIZE(HDRP(bp)) == asize ||
+           (FIT_POLICY == FIRST_FIT && GET_SIZE(HDRP(bp)) > asize))
         {
             return bp;
         }
@@ -220,21 +388,28 @@ void mm_free(void *bp)
         return;
 
     uint32_t size = GET_SIZE(HDRP(bp));
+    int cls = GET_CLASS(HDRP(bp));
 
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size, 0));
+    PUT(HDRP(bp), PACK_CLASS(size, 0, cls));
+    PUT(FTRP(bp), PACK_CLASS(size, 0, cls));
 
-    coalesce(bp);
+    last_bp = coalesce(bp);
 }
 
 //
-// coalesce - boundary tag coalescing. Return ptr to coalesced block
+// coalesce - boundary tag coalescing with free neighbours of the same
+//            lifetime class. Return ptr to coalesced block
 //
 static void *coalesce(void *bp)
 {
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
-    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    int cls = GET_CLASS(HDRP(bp));
+    // A free neighbour of another class counts as allocated here
+    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp))) ||
+                        GET_CLASS(FTRP(PREV_BLKP(bp))) != cls;
+    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp))) ||
+                        GET_CLASS(HDRP(NEXT_BLKP(bp))) != cls;
     size_t size = GET_SIZE(HDRP(bp));
+    uint32_t psize;
 
     if(prev_alloc && next_alloc)
     {
@@ -245,18 +420,20 @@ static void *coalesce(void *bp)
     {
         size = size + GET_SIZE(HDRP(NEXT_BLKP(bp)));
         listRemove((linkedlist*)NEXT_BLKP(bp));
-        PUT(HDRP(bp), PACK(size, 0));
-        PUT(FTRP(bp), PACK(size, 0));
+        PUT(HDRP(bp), PACK_CLASS(size, 0, cls));
+        PUT(FTRP(bp), PACK_CLASS(size, 0, cls));
 
         listInsert((linkedlist*)bp);
         return bp;
     }
     else if(!prev_alloc && next_alloc)
     {
-        size = size + GET_SIZE(HDRP(PREV_BLKP(bp)));
+        psize = GET_SIZE(HDRP(PREV_BLKP(bp)));
+        size = size + psize;
         bp = PREV_BLKP(bp);
-        PUT(HDRP(bp), PACK(size, 0));
-        PUT(FTRP(bp), PACK(size, 0));
+        PUT(HDRP(bp), PACK_CLASS(size, 0, cls));
+        PUT(FTRP(bp), PACK_CLASS(size, 0, cls));
+        indexResize(bp, psize);
         return bp;
     }
     else if(!prev_alloc && !next_alloc)
@@ -266,9 +443,9 @@ static void *coalesce(void *bp)
         listRemove((linkedlist*)PREV_BLKP(bp));
 
         bp = PREV_BLKP(bp);
+        PUT(HDRP(bp), PACK_CLASS(size, 0, cls));
+        PUT(FTRP(bp), PACK_CLASS(size, 0, cls));
         listInsert((linkedlist*)bp);
-        PUT(HDRP(bp), PACK(size, 0));
-        PUT(FTRP(bp), PACK(size, 0));
         return bp;
     }
     printf("something bad happened!!!");
@@ -279,24 +456,37 @@ static void *coalesce(void *bp)
 // mm_malloc - Allocate a block with at least size bytes of payload 
 //
 void *mm_malloc(uint32_t size)
+{
+    return allocate(size, MM_HINT_UNKNOWN);
+}
+
+//
+// mm_malloc_hint - mm_malloc for a block whose expected lifetime is
+//                  known to be short or long
+//
+void *mm_malloc_hint(uint32_t size, int hint)
+{
+    if(hint < 0 || hint >= NUM_CLASSES)
+    {
+        hint = MM_HINT_UNKNOWN;
+    }
+    return allocate(size, hint);
+}
+
+//
+// allocate - Allocate a block of lifetime class cls
+//
+static void *allocate(uint32_t size, int cls)
 {
     uint32_t asize;
-    uint32_t extendsize;
     void *bp;
     
-    if(size == 0)
+    if(size == 0 || size > MAX_REQUEST)
     {
         return NULL;
     }
-    else if(size == 448)
-    {
-        size = 512;
-    }
-    else if(size == 112)
-    {
-        size = 128;
-    }
-    else if(size <= DSIZE)
+    size = SIZE_CLASS(size);
+    if(size <= DSIZE)
     {
         size = 2*DSIZE;
     }
@@ -306,17 +496,12 @@ void *mm_malloc(uint32_t size)
         size = (times+1)* DSIZE;
     }
     asize = size + DSIZE;
-    if((bp = find_fit(asize)) != NULL)
+    if((bp = find_fit(asize, cls)) == NULL)
     {
-        place(bp, asize);
-        return bp;
-    }
-
-    extendsize = MAX(asize, CHUNKSIZE);
-    if((bp = extend_heap(extendsize/WSIZE)) == NULL)
         return NULL;
-
-    place(bp, asize);
+    }
+    bp = place(bp, asize);
+    last_bp = bp;
     return bp;
 }
 
@@ -324,30 +509,33 @@ void *mm_malloc(uint32_t size)
 //
 // Practice problem 9.9
 //
-// place - Place block of asize bytes at start of free block bp 
-//         and split if remainder would be at least minimum block size
+// place - Place block of asize bytes at start of free block bp and
+//         split if remainder would be at least SPLIT_THRESHOLD; both
+//         parts keep the free block's class. Returns the allocated
+//         block.
 //
-static void place(void *bp, uint32_t asize)
+static void *place(void *bp, uint32_t asize)
 {
     uint32_t csize = GET_SIZE(HDRP(bp));
+    int cls = GET_CLASS(HDRP(bp));
 
-    if((csize - asize) >= 24)
+    listRemove((linkedlist*)bp);
+    if((csize - asize) >= SPLIT_THRESHOLD)
     {
-        PUT(HDRP(bp), PACK(asize, 1));
-        PUT(FTRP(bp), PACK(asize, 1));
-        listRemove((linkedlist*)bp);
+        PUT(HDRP(bp), PACK_CLASS(asize, 1, cls));
+        PUT(FTRP(bp), PACK_CLASS(asize, 1, cls));
 
-        bp = NEXT_BLKP(bp);
-        PUT(HDRP(bp), PACK(csize - asize, 0));
-        PUT(FTRP(bp), PACK(csize - asize, 0));
-        listInsert((linkedlist*)bp);
+        void *rest = NEXT_BLKP(bp);
+        PUT(HDRP(rest), PACK_CLASS(csize - asize, 0, cls));
+        PUT(FTRP(rest), PACK_CLASS(csize - asize, 0, cls));
+        listInsert((linkedlist*)rest);
     }
     else
     {
-        PUT(HDRP(bp), PACK(csize, 1));
-        PUT(FTRP(bp), PACK(csize, 1));
-        listRemove((linkedlist*)bp);
+        PUT(HDRP(bp), PACK_CLASS(csize, 1, cls));
+        PUT(FTRP(bp), PACK_CLASS(csize, 1, cls));
     }
+    return bp;
 }
 
 
@@ -355,10 +543,33 @@ static void place(void *bp, uint32_t asize)
 // mm_realloc -- implemented for you
 //
 void *mm_realloc(void *ptr, uint32_t size)
+{
+    return mm_realloc_aligned(ptr, DSIZE, size);
+}
+
+//
+// mm_realloc_aligned - mm_realloc for blocks from mm_memalign; if the
+//                      block has to move, the new payload is aligned too
+//
+void *mm_realloc_aligned(void *ptr, size_t align, uint32_t size)
 {
     void *newp;
     uint32_t copySize;
 
+    if(ptr == NULL)
+    {
+        return mm_memalign(align, size);
+    }
+    if(size == 0)
+    {
+        mm_free(ptr);
+        return NULL;
+    }
+    if(size > MAX_REQUEST)
+    {
+        return NULL;
+    }
+
     uint32_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(ptr)));
 
     uint32_t next_size = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
@@ -367,25 +578,58 @@ void *mm_realloc(void *ptr, uint32_t size)
     uint32_t combine_size = curr_size + next_size;
     uint32_t asize = size + DSIZE;
     
-    if(curr_size > asize)
+    if(curr_size >= asize)
     {
+        last_bp = ptr;
         return ptr;
     }
     
+    if(!next_alloc && GET_CLASS(HDRP(NEXT_BLKP(ptr))) != GET_CLASS(HDRP(ptr)))
+    {
+        // The next block belongs to another class and cannot be absorbed
+        next_alloc = 1;
+        next_size = 0;
+        combine_size = curr_size;
+    }
+
+    // At the end of the heap, grow the heap under the block rather
+    // than move it
+    if(GET_SIZE(HDRP(NEXT_BLKP(ptr))) == 0 ||
+       (!next_alloc && GET_SIZE(HDRP(NEXT_BLKP(NEXT_BLKP(ptr)))) == 0))
+    {
+        // The new free block must be large enough for its list links
+        if(combine_size < asize &&
+           extend_heap(MAX(asize - combine_size, MINBLOCK)/WSIZE + 1,
+                       GET_CLASS(HDRP(ptr))) != NULL)
+        {
+            next_alloc = 0;
+            next_size = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
+            combine_size = curr_size + next_size;
+        }
+    }
+    
     if(!next_alloc && combine_size >= asize)
     {
         listRemove((linkedlist*)NEXT_BLKP(ptr));
-        PUT(HDRP(ptr), PACK(combine_size, 1));
-        PUT(FTRP(ptr), PACK(combine_size, 1));
+        PUT(HDRP(ptr), PACK_CLASS(combine_size, 1, GET_CLASS(HDRP(ptr))));
+        PUT(FTRP(ptr), PACK_CLASS(combine_size, 1, GET_CLASS(HDRP(ptr))));
             
+        last_bp = ptr;
         return ptr;
     }
 
-    newp = mm_malloc(size);
+    // A moved block keeps its lifetime class
+    if(align <= DSIZE)
+    {
+        newp = allocate(size, GET_CLASS(HDRP(ptr)));
+    }
+    else
+    {
+        newp = mm_memalign(align, size);
+    }
     if (newp == NULL)
     {
-        printf("ERROR: mm_malloc failed in mm_realloc\n");
-        exit(1);
+        return NULL;
     }
     copySize = GET_SIZE(HDRP(ptr));
     if(size < copySize)
@@ -397,45 +641,171 @@ void *mm_realloc(void *ptr, uint32_t size)
     return newp;
 }
 
-// inserts to free list
+//
+// mm_memalign - Allocate a block whose payload address is a multiple
+//               of align, which must be a power of two
+//
+void *mm_memalign(size_t align, uint32_t size)
+{
+    char *bp;
+    char *abp;
+    void *prev;
+    uint32_t csize;
+    uint32_t psize;
+    uint32_t asize;
+    uint32_t shift;
+    int cls;
+
+    if(align <= DSIZE)
+    {
+        return mm_malloc(size);
+    }
+    // Check align on its own first: size_t arithmetic with an align of
+    // 2^32 or more would wrap, and the request below is 32 bits
+    if(size == 0 || align > UINT32_MAX / 2 ||
+       size > UINT32_MAX - align - 2*MINBLOCK)
+    {
+        return NULL;
+    }
+
+    // The payload has to move up by at most align - DSIZE bytes, and
+    // what remains must still be large enough to hold free list links
+    size = MAX(size, 2*DSIZE);
+    if((bp = mm_malloc(size + align - DSIZE)) == NULL)
+    {
+        return NULL;
+    }
+    abp = (char *)(((uintptr_t)bp + align - 1) & ~(uintptr_t)(align - 1));
+    shift = abp - bp;
+    prev = PREV_BLKP(bp);
+    csize = GET_SIZE(HDRP(bp));
+    cls = GET_CLASS(HDRP(bp));
+
+    if(shift >= MINBLOCK)
+    {
+        // Give the leading fragment back as a free block
+        PUT(HDRP(abp), PACK_CLASS(csize - shift, 1, cls));
+        PUT(FTRP(abp), PACK_CLASS(csize - shift, 1, cls));
+        PUT(HDRP(bp), PACK_CLASS(shift, 0, cls));
+        PUT(FTRP(bp), PACK_CLASS(shift, 0, cls));
+        coalesce(bp);
+    }
+    else if(shift > 0 && prev != heap_listp)
+    {
+        // Too small for a block, so the previous block absorbs it
+        psize = GET_SIZE(HDRP(prev));
+        PUT(HDRP(prev), PACK_CLASS(psize + shift, GET_ALLOC(HDRP(prev)),
+                                   GET_CLASS(HDRP(prev))));
+        PUT(FTRP(prev), GET(HDRP(prev)));
+        if(!GET_ALLOC(HDRP(prev)))
+        {
+            indexResize(prev, psize);
+        }
+        PUT(HDRP(abp), PACK_CLASS(csize - shift, 1, cls));
+        PUT(FTRP(abp), PACK_CLASS(csize - shift, 1, cls));
+    }
+    else if(shift > 0)
+    {
+        // The prologue cannot grow; retry with room for a free block
+        mm_free(bp);
+        if((bp = mm_malloc(size + align + MINBLOCK)) == NULL)
+        {
+            return NULL;
+        }
+        abp = (char *)(((uintptr_t)bp + MINBLOCK + align - 1) &
+                       ~(uintptr_t)(align - 1));
+        csize = GET_SIZE(HDRP(bp));
+        cls = GET_CLASS(HDRP(bp));
+        PUT(HDRP(abp), PACK_CLASS(csize - (abp - bp), 1, cls));
+        PUT(FTRP(abp), PACK_CLASS(csize - (abp - bp), 1, cls));
+        PUT(HDRP(bp), PACK_CLASS(abp - bp, 0, cls));
+        PUT(FTRP(bp), PACK_CLASS(abp - bp, 0, cls));
+        coalesce(bp);
+    }
+
+    // Free whatever is left over at the end
+    asize = (size + DSIZE - 1) & ~(DSIZE - 1);
+    trim(abp, asize + DSIZE);
+    last_bp = abp;
+    return abp;
+}
+
+//
+// trim - Shrink allocated block bp to asize bytes, freeing the tail
+//        if it is large enough to be a block of its own
+//
+static void trim(void *bp, uint32_t asize)
+{
+    uint32_t csize = GET_SIZE(HDRP(bp));
+    int cls = GET_CLASS(HDRP(bp));
+    void *tail;
+
+    if(csize - asize < MINBLOCK)
+    {
+        return;
+    }
+    PUT(HDRP(bp), PACK_CLASS(asize, 1, cls));
+    PUT(FTRP(bp), PACK_CLASS(asize, 1, cls));
+    tail = NEXT_BLKP(bp);
+    PUT(HDRP(tail), PACK_CLASS(csize - asize, 0, cls));
+    PUT(FTRP(tail), PACK_CLASS(csize - asize, 0, cls));
+    coalesce(tail);
+}
+
+//
+// mm_usable_size - Number of payload bytes available in block bp
+//
+uint32_t mm_usable_size(void *bp)
+{
+    return GET_SIZE(HDRP(bp)) - DSIZE;
+}
+
+// inserts to the free list of the block's lifetime class
 static void listInsert(linkedlist *bp)
 {
+    linkedlist **head = &firstlist[GET_CLASS(HDRP(bp))];
+
     if(GET_ALLOC(HDRP(bp)))
     {
         return;
     }
 
-    if(firstlist == NULL)
+    if(*head == NULL)
     {
-        firstlist = bp;
+        *head = bp;
         bp->next = NULL;
         bp->prev = NULL;
     }
-    else if(firstlist != NULL)
+    else if(*head != NULL)
     {
-        bp->prev = firstlist->prev;
-        bp->next = firstlist;
-        firstlist->prev = bp;
-        firstlist = bp;
+        bp->prev = (*head)->prev;
+        bp->next = *head;
+        (*head)->prev = bp;
+        *head = bp;
     }
+    indexInsert(bp);
 }
 
-// removes from free list
+// removes from free list; the block's class must not have changed
+// since it was inserted
 static void listRemove(linkedlist* bp)
 {
+    linkedlist **head = &firstlist[GET_CLASS(HDRP(bp))];
+
     if(GET_SIZE(HDRP(bp)) == 0)
     {
         PUT(HDRP(bp), PACK(0,1));
         return;
     }
+    indexRemove(bp);
     if(bp->next == NULL && bp->prev == NULL)
     {
-        firstlist = NULL;
+        *head = NULL;
     }
     else if(bp->prev == NULL && bp->next != NULL)
     {
-        firstlist = bp->next;
-        firstlist->prev = NULL;
+        *head = bp->next;
+        (*head)->prev = NULL;
     }
     else if(bp->prev != NULL && bp->next == NULL)
     {
@@ -449,3 +819,592 @@ static void listRemove(linkedlist* bp)
         bp->next = NULL;
     }
 }
+
+#if FIT_INDEX
+/////////////////////////////////////////////////////////////////////////////
+//
+// Free-size index
+//
+// A block is appended to its class's index when it goes on a free list
+// and records its slot after its links; when it comes off, the last
+// entry moves into the slot, so the sizes stay contiguous. indexFit
+// finds the smallest size that fits in one pass of unsigned min/max
+// compares and then the slot holding it with a second, equality pass.
+// MINBLOCK blocks have no room for a slot and only fit MINBLOCK
+// requests, which walk the list while the class has any. A class with
+// more than FIT_INDEX_MAX free blocks goes back to walking its list
+// until the next mm_init. Ties between equal sizes go to the lowest
+// slot rather than the head of the list, so placement can differ
+// slightly from the list walk.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+// Smallest of the n sizes that is at least asize (asize itself as soon
+// as it is seen), or UINT32_MAX if none is
+static uint32_t (*min_fit)(const uint32_t *size, uint32_t n, uint32_t asize);
+
+// First of the n sizes that is v, or n if none is
+static uint32_t (*find_slot)(const uint32_t *a, uint32_t n, uint32_t v);
+
+static uint32_t min_fit_scalar(const uint32_t *size, uint32_t n,
+                               uint32_t asize)
+{
+    uint32_t best = UINT32_MAX;
+    uint32_t i;
+
+    for(i = 0; i < n; i++)
+    {
+        if(size[i] == asize)
+        {
+            return asize;
+        }
+        if(size[i] > asize && size[i] < best)
+        {
+            best = size[i];
+        }
+    }
+    return best;
+}
+
+static uint32_t find_slot_scalar(const uint32_t *a, uint32_t n, uint32_t v)
+{
+    uint32_t i;
+
+    for(i = 0; i < n && a[i] != v; i++)
+        ;
+    return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// Smallest of n vector lanes and min
+static inline uint32_t lanes_min(const uint32_t *lanes, int n, uint32_t min)
+{
+    int i;
+
+    for(i = 0; i < n; i++)
+    {
+        min = lanes[i] < min ? lanes[i] : min;
+    }
+    return min;
+}
+
+__attribute__((target("sse4.1")))
+static uint32_t min_fit_sse4(const uint32_t *size, uint32_t n, uint32_t asize)
+{
+    __m128i want = _mm_set1_epi32(asize);
+    __m128i best = _mm_set1_epi32(-1);
+    uint32_t lanes[4];
+    uint32_t i;
+
+    for(i = 0; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(size + i));
+        __m128i fits = _mm_cmpeq_epi32(_mm_max_epu32(v, want), v);
+
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(v, want)))
+        {
+            return asize;
+        }
+        // Sizes that do not fit become UINT32_MAX
+        best = _mm_min_epu32(best, _mm_or_si128(v, _mm_xor_si128(fits,
+                                                _mm_set1_epi32(-1))));
+    }
+    _mm_storeu_si128((__m128i *)lanes, best);
+    return lanes_min(lanes, 4, min_fit_scalar(size + i, n - i, asize));
+}
+
+__attribute__((target("sse4.1")))
+static uint32_t find_slot_sse4(const uint32_t *a, uint32_t n, uint32_t v)
+{
+    __m128i want = _mm_set1_epi32(v);
+    uint32_t i;
+    int mask;
+
+    for(i = 0; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+
+        if((mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, want)))))
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + find_slot_scalar(a + i, n - i, v);
+}
+
+__attribute__((target("avx2")))
+static uint32_t min_fit_avx2(const uint32_t *size, uint32_t n, uint32_t asize)
+{
+    __m256i want = _mm256_set1_epi32(asize);
+    __m256i ones = _mm256_set1_epi32(-1);
+    __m256i best = ones;
+    uint32_t lanes[8];
+    uint32_t i;
+
+    for(i = 0; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(size + i));
+        __m256i fits = _mm256_cmpeq_epi32(_mm256_max_epu32(v, want), v);
+
+        if(_mm256_movemask_epi8(_mm256_cmpeq_epi32(v, want)))
+        {
+            return asize;
+        }
+        best = _mm256_min_epu32(best, _mm256_or_si256(v,
+                                _mm256_xor_si256(fits, ones)));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, best);
+    return lanes_min(lanes, 8, min_fit_scalar(size + i, n - i, asize));
+}
+
+__attribute__((target("avx2")))
+static uint32_t find_slot_avx2(const uint32_t *a, uint32_t n, uint32_t v)
+{
+    __m256i want = _mm256_set1_epi32(v);
+    uint32_t i;
+    int mask;
+
+    for(i = 0; i + 8 <= n; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+
+        if((mask = _mm256_movemask_ps(_mm256_castsi256_ps(
+                                         _mm256_cmpeq_epi32(x, want)))))
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + find_slot_scalar(a + i, n - i, v);
+}
+#endif
+
+//
+// indexInit - Empty every class's index and pick the scan kernels for
+//             this CPU
+//
+static void indexInit(void)
+{
+    int i;
+
+    for(i = 0; i < NUM_CLASSES; i++)
+    {
+        fit_index[i].count = 0;
+        fit_index[i].small = 0;
+        fit_index[i].overflow = 0;
+    }
+    if(min_fit != NULL)
+    {
+        return;
+    }
+    min_fit = min_fit_scalar;
+    find_slot = find_slot_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        min_fit = min_fit_avx2;
+        find_slot = find_slot_avx2;
+    }
+    else if(__builtin_cpu_supports("sse4.1"))
+    {
+        min_fit = min_fit_sse4;
+        find_slot = find_slot_sse4;
+    }
+#endif
+}
+
+//
+// indexInsert - Append free block bp to the index of its class
+//
+static void indexInsert(void *bp)
+{
+    fitindex *ix = &fit_index[GET_CLASS(HDRP(bp))];
+
+    if(ix->overflow)
+    {
+        return;
+    }
+    if(GET_SIZE(HDRP(bp)) <= MINBLOCK)
+    {
+        ix->small++;
+        return;
+    }
+    if(ix->count == FIT_INDEX_MAX)
+    {
+        ix->overflow = 1;
+        return;
+    }
+    ix->size[ix->count] = GET_SIZE(HDRP(bp));
+    ix->offset[ix->count] = (char *)bp - heap_listp;
+    *SLOTP(bp) = ix->count++;
+}
+
+//
+// indexRemove - Drop free block bp from the index of its class
+//
+static void indexRemove(void *bp)
+{
+    fitindex *ix = &fit_index[GET_CLASS(HDRP(bp))];
+    uint32_t slot;
+
+    if(ix->overflow)
+    {
+        return;
+    }
+    if(GET_SIZE(HDRP(bp)) <= MINBLOCK)
+    {
+        ix->small--;
+        return;
+    }
+    slot = *SLOTP(bp);
+    ix->count--;
+    ix->size[slot] = ix->size[ix->count];
+    ix->offset[slot] = ix->offset[ix->count];
+    *SLOTP(heap_listp + ix->offset[slot]) = slot;
+}
+
+//
+// indexResize - Record the new size of free block bp, which grew from
+//               oldsize bytes without leaving its list
+//
+static void indexResize(void *bp, uint32_t oldsize)
+{
+    fitindex *ix = &fit_index[GET_CLASS(HDRP(bp))];
+
+    if(ix->overflow)
+    {
+        return;
+    }
+    if(oldsize <= MINBLOCK)
+    {
+        ix->small--;
+        indexInsert(bp);
+        return;
+    }
+    ix->size[*SLOTP(bp)] = GET_SIZE(HDRP(bp));
+}
+
+//
+// indexFit - Free block in ix with at least asize bytes, chosen by
+//            FIT_POLICY
+//
+static void *indexFit(fitindex *ix, uint32_t asize)
+{
+    uint32_t size;
+    uint32_t slot;
+
+    if(FIT_POLICY == FIRST_FIT)
+    {
+        for(slot = 0; slot < ix->count && ix->size[slot] < asize; slot++)
+            ;
+    }
+    else if(ix->count < FIT_INDEX_SIMD)
+    {
+        // Too short to pay for the kernels; one scalar pass
+        uint32_t best = UINT32_MAX;
+
+        for(slot = ix->count, size = 0; size < ix->count; size++)
+        {
+            if(ix->size[size] >= asize && ix->size[size] < best)
+            {
+                best = ix->size[size];
+                slot = size;
+                if(best == asize)
+                    break;
+            }
+        }
+    }
+    else if((size = min_fit(ix->size, ix->count, asize)) == UINT32_MAX)
+    {
+        return NULL;
+    }
+    else
+    {
+        slot = find_slot(ix->size, ix->count, size);
+    }
+    return slot < ix->count ? heap_listp + ix->offset[slot] : NULL;
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Heap consistency checker
+//
+// mm_checkheap(MM_CHECK_SAMPLE) only looks at the blocks around the one
+// touched by the most recent operation, so its cost is bounded by
+// CHECK_WINDOW and independent of the heap size. MM_CHECK_FULL walks
+// every block and MM_CHECK_LISTS additionally cross-checks the free
+// lists against the heap. Returns 0 if no problem was found, -1 otherwise.
+//
+/////////////////////////////////////////////////////////////////////////////
+#define CHECK_WINDOW 8      /* blocks visited on each side of last_bp */
+
+static inline int inHeap(void *p)
+{
+    return (char *)p >= heap_listp && (char *)p <= (char *)mem_heap_hi();
+}
+
+//
+// checkBlock - Verify a single block's boundary tags
+//
+static int checkBlock(void *bp)
+{
+    uint32_t size = GET_SIZE(HDRP(bp));
+
+    if((uintptr_t)bp % DSIZE != 0)
+    {
+        fprintf(stderr, "mm_checkheap: block %p is not aligned\n", bp);
+        return -1;
+    }
+    if(size < MINBLOCK || size % DSIZE != 0)
+    {
+        fprintf(stderr, "mm_checkheap: block %p has bad size %u\n", bp, size);
+        return -1;
+    }
+    if(!inHeap((char *)bp + size - WSIZE))
+    {
+        fprintf(stderr, "mm_checkheap: block %p (size %u) runs past the heap\n",
+                bp, size);
+        return -1;
+    }
+    if(GET_CLASS(HDRP(bp)) >= NUM_CLASSES)
+    {
+        fprintf(stderr, "mm_checkheap: block %p has bad lifetime class %d\n",
+                bp, GET_CLASS(HDRP(bp)));
+        return -1;
+    }
+    if(GET(HDRP(bp)) != GET(FTRP(bp)))
+    {
+        fprintf(stderr, "mm_checkheap: block %p header %#x != footer %#x\n",
+                bp, GET(HDRP(bp)), GET(FTRP(bp)));
+        return -1;
+    }
+    return 0;
+}
+
+//
+// checkLinks - Verify that a free block is linked consistently with
+//              its free list neighbours
+//
+static int checkLinks(linkedlist *bp)
+{
+    linkedlist *head = firstlist[GET_CLASS(HDRP(bp))];
+
+    if(bp->prev == NULL ? head != bp : bp->prev->next != bp)
+    {
+        fprintf(stderr, "mm_checkheap: free block %p has a broken prev link\n",
+                (void *)bp);
+        return -1;
+    }
+    if(bp->next != NULL && (!inHeap(bp->next) || bp->next->prev != bp))
+    {
+        fprintf(stderr, "mm_checkheap: free block %p has a broken next link\n",
+                (void *)bp);
+        return -1;
+    }
+    return 0;
+}
+
+//
+// checkBoundaries - Verify the prologue and epilogue blocks
+//
+static int checkBoundaries(void)
+{
+    void *epilogue = (char *)mem_heap_hi() + 1;
+
+    if(GET(HDRP(heap_listp)) != PACK(DSIZE, 1) ||
+       GET(FTRP(heap_listp)) != PACK(DSIZE, 1))
+    {
+        fprintf(stderr, "mm_checkheap: bad prologue block\n");
+        return -1;
+    }
+    if(GET(HDRP(epilogue)) != PACK(0, 1))
+    {
+        fprintf(stderr, "mm_checkheap: bad epilogue header\n");
+        return -1;
+    }
+    return 0;
+}
+
+//
+// checkWindow - Sampled check of the blocks surrounding last_bp
+//
+static int checkWindow(void)
+{
+    void *bp = last_bp;
+    int i;
+
+    if(bp == NULL || checkBlock(bp) < 0)
+        return bp == NULL ? 0 : -1;
+
+    // Step back over at most CHECK_WINDOW blocks, stopping at the prologue
+    for(i = 0; i < CHECK_WINDOW; i++)
+    {
+        void *ftr = (char *)bp - DSIZE;
+        uint32_t size = GET_SIZE(ftr);
+
+        if(ftr == FTRP(heap_listp))
+            break;
+        if(size < MINBLOCK || !inHeap((char *)bp - size))
+        {
+            fprintf(stderr, "mm_checkheap: bad footer before block %p\n", bp);
+            return -1;
+        }
+        bp = PREV_BLKP(bp);
+    }
+
+    // Walk forward across the window, checking tags, links and coalescing
+    for(i = 0; i < 2*CHECK_WINDOW + 1 && GET_SIZE(HDRP(bp)) > 0; i++)
+    {
+        if(checkBlock(bp) < 0)
+            return -1;
+        if(!GET_ALLOC(HDRP(bp)))
+        {
+            if(checkLinks((linkedlist *)bp) < 0)
+                return -1;
+            if(!GET_ALLOC(HDRP(NEXT_BLKP(bp))) &&
+               GET_CLASS(HDRP(NEXT_BLKP(bp))) == GET_CLASS(HDRP(bp)))
+            {
+                fprintf(stderr, "mm_checkheap: free blocks %p and %p were not "
+                        "coalesced\n", bp, NEXT_BLKP(bp));
+                return -1;
+            }
+        }
+        bp = NEXT_BLKP(bp);
+    }
+    return 0;
+}
+
+//
+// mm_checkheap - Check the heap for consistency
+//
+int mm_checkheap(int level)
+{
+    void *bp;
+    linkedlist *lp;
+    long free_blocks = 0;
+    long listed = 0;
+    int i;
+
+    if(checkBoundaries() < 0)
+        return -1;
+
+    if(level == MM_CHECK_SAMPLE)
+        return checkWindow();
+
+    for(bp = NEXT_BLKP(heap_listp); GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+    {
+        if(checkBlock(bp) < 0)
+            return -1;
+        if(!GET_ALLOC(HDRP(bp)))
+        {
+            free_blocks++;
+            if(!GET_ALLOC(HDRP(NEXT_BLKP(bp))) &&
+               GET_CLASS(HDRP(NEXT_BLKP(bp))) == GET_CLASS(HDRP(bp)))
+            {
+                fprintf(stderr, "mm_checkheap: free blocks %p and %p were not "
+                        "coalesced\n", bp, NEXT_BLKP(bp));
+                return -1;
+            }
+        }
+    }
+    if((char *)bp != (char *)mem_heap_hi() + 1)
+    {
+        fprintf(stderr, "mm_checkheap: heap walk ended at %p, not at the "
+                "epilogue\n", bp);
+        return -1;
+    }
+
+    if(level < MM_CHECK_LISTS)
+        return 0;
+
+    // Every list node must be a free heap block of the list's class, and
+    // every free block must be on a list; bounding the walk also catches
+    // cycles
+    for(i = 0; i < NUM_CLASSES; i++)
+    for(lp = firstlist[i]; lp != NULL; lp = lp->next)
+    {
+        if(++listed > free_blocks)
+        {
+            fprintf(stderr, "mm_checkheap: free list is longer than the %ld "
+                    "free blocks in the heap (cycle?)\n", free_blocks);
+            return -1;
+        }
+        if(!inHeap(lp) || checkBlock(lp) < 0)
+            return -1;
+        if(GET_ALLOC(HDRP(lp)))
+        {
+            fprintf(stderr, "mm_checkheap: allocated block %p is on the free "
+                    "list\n", (void *)lp);
+            return -1;
+        }
+        if(GET_CLASS(HDRP(lp)) != i)
+        {
+            fprintf(stderr, "mm_checkheap: class %d block %p is on the class "
+                    "%d free list\n", GET_CLASS(HDRP(lp)), (void *)lp, i);
+            return -1;
+        }
+        if(checkLinks(lp) < 0)
+            return -1;
+    }
+    if(listed != free_blocks)
+    {
+        fprintf(stderr, "mm_checkheap: %ld free blocks in the heap but %ld on "
+                "the free lists\n", free_blocks, listed);
+        return -1;
+    }
+#if FIT_INDEX
+    return checkIndex();
+#else
+    return 0;
+#endif
+}
+
+#if FIT_INDEX
+//
+// checkIndex - Verify that each index entry is a free block of its
+//              class with the recorded size and slot, and that each
+//              list has as many blocks as its index has entries and
+//              small blocks
+//
+static int checkIndex(void)
+{
+    fitindex *ix;
+    linkedlist *lp;
+    uint32_t slot;
+    long listed;
+    int i;
+
+    for(i = 0; i < NUM_CLASSES; i++)
+    {
+        ix = &fit_index[i];
+        if(ix->overflow)
+            continue;
+        for(slot = 0; slot < ix->count; slot++)
+        {
+            void *bp = heap_listp + ix->offset[slot];
+
+            if(!inHeap(bp) || GET_ALLOC(HDRP(bp)) || GET_CLASS(HDRP(bp)) != i ||
+               GET_SIZE(HDRP(bp)) != ix->size[slot] || *SLOTP(bp) != slot)
+            {
+                fprintf(stderr, "mm_checkheap: index entry %u of class %d "
+                        "(%p, size %u) is not a free block of that size\n",
+                        slot, i, bp, ix->size[slot]);
+                return -1;
+            }
+        }
+        for(listed = 0, lp = firstlist[i]; lp != NULL; lp = lp->next)
+            listed++;
+        if(listed != ix->count + ix->small)
+        {
+            fprintf(stderr, "mm_checkheap: class %d has %ld free blocks but "
+                    "%u index entries and %u small blocks\n", i, listed,
+                    ix->count, ix->small);
+            return -1;
+        }
+    }
+    return 0;
+}
+#endif
@@ -5,6 +5,23 @@ extern int mm_init (void);
 extern void *mm_malloc (uint32_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, uint32_t size);
+extern void *mm_memalign(size_t align, uint32_t size);
+extern void *mm_realloc_aligned(void *ptr, size_t align, uint32_t size);
+extern uint32_t mm_usable_size(void *ptr);
+
+/* Expected lifetime of a block, for mm_malloc_hint() */
+#define MM_HINT_UNKNOWN 0   /* same placement as mm_malloc */
+#define MM_HINT_SHORT   1   /* freed soon after it is allocated */
+#define MM_HINT_LONG    2   /* lives for much of the program */
+
+extern void *mm_malloc_hint(uint32_t size, int hint);
+
+/* Heap consistency checker levels for mm_checkheap() */
+#define MM_CHECK_SAMPLE 0   /* blocks around the most recent operation */
+#define MM_CHECK_FULL   1   /* every block in the heap */
+#define MM_CHECK_LISTS  2   /* every block plus the free list */
+
+extern int mm_checkheap(int level);
 
 
 /* 
@@ -0,0 +1,121 @@
+/*
+ * mm_allocator.h - C++ adapters for the mm package
+ *
+ *   mm_memory_resource  a std::pmr::memory_resource over the mm heap, for
+ *                       std::pmr containers and polymorphic_allocator
+ *   mm_allocator<T>     a stateless Allocator for ordinary STL containers
+ *
+ * There is one mm heap per process, so every mm_memory_resource and
+ * every mm_allocator is interchangeable: memory allocated through one
+ * may be released through any other. Like mm.c itself these adapters
+ * are not thread-safe.
+ *
+ * Without mm_new.o, the program owns the heap and must set it up with
+ * mem_init() and mm_init() before using the adapters. Link with
+ * mm_new.o instead to also route the global operator new and delete
+ * through mm; mm_new.o then owns the heap, creating it on the first
+ * operator new, possibly before main(). Such a program must not call
+ * mem_init() or mm_init(), which would reset the heap under live C++
+ * objects. The adapters do not take mm_new.o's lock, so they may only
+ * be used while no other thread can be in operator new or delete.
+ */
+#ifndef __MM_ALLOCATOR_H_
+#define __MM_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <new>
+
+extern "C" {
+#include "mm.h"
+#include "memlib.h"
+}
+
+namespace mm_detail {
+
+/* mm_malloc/mm_memalign with C++ error handling: throws std::bad_alloc */
+inline void *allocate(std::size_t bytes, std::size_t align)
+{
+    void *p;
+
+    if (bytes > std::numeric_limits<uint32_t>::max() / 2)
+        throw std::bad_alloc();
+    if (bytes == 0)
+        bytes = 1;
+    p = (align <= 8) ? mm_malloc((uint32_t)bytes)
+                     : mm_memalign(align, (uint32_t)bytes);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+} // namespace mm_detail
+
+/*
+ * mm_memory_resource - memory resource backed by the mm heap
+ */
+class mm_memory_resource : public std::pmr::memory_resource {
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        return mm_detail::allocate(bytes, align);
+    }
+
+    void do_deallocate(void *p, std::size_t, std::size_t) override
+    {
+        mm_free(p);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return dynamic_cast<const mm_memory_resource *>(&other) != nullptr;
+    }
+};
+
+/* A process-wide instance, for code that just needs a resource pointer */
+inline mm_memory_resource *mm_resource()
+{
+    static mm_memory_resource resource;
+    return &resource;
+}
+
+/*
+ * mm_allocator - STL Allocator backed by the mm heap
+ */
+template <class T>
+class mm_allocator {
+public:
+    typedef T value_type;
+
+    mm_allocator() noexcept = default;
+    template <class U>
+    mm_allocator(const mm_allocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n)
+    {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            throw std::bad_alloc();
+        return static_cast<T *>(mm_detail::allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, std::size_t) noexcept
+    {
+        mm_free(p);
+    }
+};
+
+template <class T, class U>
+inline bool operator==(const mm_allocator<T> &, const mm_allocator<U> &) noexcept
+{
+    return true;
+}
+
+template <class T, class U>
+inline bool operator!=(const mm_allocator<T> &, const mm_allocator<U> &) noexcept
+{
+    return false;
+}
+
+#endif /* __MM_ALLOCATOR_H_ */
@@ -0,0 +1,162 @@
+/*
+ * mm_arena.c - region allocator on top of the mm heap
+ *
+ * The arena keeps a list of chunks obtained from mm_malloc. The first
+ * chunk also holds the arena itself. Allocation bumps a pointer through
+ * the current chunk and moves on to the next chunk in the list (or a
+ * new one) when it runs out, so after a reset the chunks of earlier
+ * rounds are refilled before mm is asked for more. Requests larger than
+ * a quarter of a chunk get a chunk of their own on a separate list,
+ * which reset gives back to mm; everything else about reset is O(1).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mm.h"
+#include "mm_arena.h"
+
+#define ARENA_ALIGN 8            /* same alignment as mm_malloc */
+#define DEFAULT_CHUNK (1 << 16)  /* default chunk size (bytes) */
+#define MIN_CHUNK 256            /* smallest chunk size accepted */
+
+/* Header at the start of every chunk */
+typedef struct chunk {
+    struct chunk *next; /* next chunk in the list */
+    char *end;          /* one past the last usable byte */
+} chunk_t;
+
+struct mm_arena {
+    chunk_t *first;     /* chunk that holds this struct */
+    chunk_t *cur;       /* chunk being bumped through */
+    char *ptr;          /* next free byte in cur */
+    chunk_t *large;     /* dedicated chunks for large requests */
+    uint32_t chunk_size;
+};
+
+#define ALIGN(n) (((n) + (ARENA_ALIGN - 1)) & ~(uintptr_t)(ARENA_ALIGN - 1))
+#define CHUNK_HDR ALIGN(sizeof(chunk_t))
+#define ARENA_HDR ALIGN(sizeof(struct mm_arena))
+
+/* function prototypes */
+static chunk_t *new_chunk(uint32_t size);
+static void *next_chunk(mm_arena_t *arena, uint32_t size);
+static void *alloc_large(mm_arena_t *arena, uint32_t size);
+
+/*
+ * mm_arena_create - make an arena, placing it in its first chunk
+ */
+mm_arena_t *mm_arena_create(uint32_t chunk_size)
+{
+    mm_arena_t *arena;
+    chunk_t *c;
+
+    if (chunk_size == 0)
+	chunk_size = DEFAULT_CHUNK;
+    if (chunk_size < MIN_CHUNK)
+	chunk_size = MIN_CHUNK;
+    chunk_size = ALIGN(chunk_size);
+
+    if ((c = new_chunk(chunk_size)) == NULL)
+	return NULL;
+    arena = (mm_arena_t *)((char *)c + CHUNK_HDR);
+    arena->first = c;
+    arena->cur = c;
+    arena->ptr = (char *)arena + ARENA_HDR;
+    arena->large = NULL;
+    arena->chunk_size = chunk_size;
+    return arena;
+}
+
+/*
+ * mm_arena_alloc - bump allocate size bytes
+ */
+void *mm_arena_alloc(mm_arena_t *arena, uint32_t size)
+{
+    char *p = arena->ptr;
+    uintptr_t asize = ALIGN((uintptr_t)size);
+
+    if (asize <= (uintptr_t)(arena->cur->end - p)) {
+	arena->ptr = p + asize;
+	return p;
+    }
+    if (asize > arena->chunk_size / 4)
+	return alloc_large(arena, size);
+    return next_chunk(arena, (uint32_t)asize);
+}
+
+/*
+ * mm_arena_reset - forget every allocation but keep the chunks
+ */
+void mm_arena_reset(mm_arena_t *arena)
+{
+    chunk_t *c, *next;
+
+    for (c = arena->large; c != NULL; c = next) {
+	next = c->next;
+	mm_free(c);
+    }
+    arena->large = NULL;
+    arena->cur = arena->first;
+    arena->ptr = (char *)arena + ARENA_HDR;
+}
+
+/*
+ * mm_arena_destroy - give every chunk, including the arena's, back to mm
+ */
+void mm_arena_destroy(mm_arena_t *arena)
+{
+    chunk_t *c, *next;
+
+    mm_arena_reset(arena);
+    for (c = arena->first; c != NULL; c = next) {
+	next = c->next;
+	mm_free(c);
+    }
+}
+
+/*
+ * new_chunk - get a chunk of size bytes (header included) from mm
+ */
+static chunk_t *new_chunk(uint32_t size)
+{
+    chunk_t *c;
+
+    if ((c = (chunk_t *)mm_malloc(size)) == NULL)
+	return NULL;
+    c->next = NULL;
+    c->end = (char *)c + size;
+    return c;
+}
+
+/*
+ * next_chunk - the current chunk is full: move to the next one kept
+ *    from an earlier round, or append a new one, and allocate there
+ */
+static void *next_chunk(mm_arena_t *arena, uint32_t size)
+{
+    chunk_t *c = arena->cur->next;
+
+    if (c == NULL) {
+	if ((c = new_chunk(arena->chunk_size)) == NULL)
+	    return NULL;
+	arena->cur->next = c;
+    }
+    arena->cur = c;
+    arena->ptr = (char *)c + CHUNK_HDR + size;
+    return (char *)c + CHUNK_HDR;
+}
+
+/*
+ * alloc_large - give a large request a chunk of its own
+ */
+static void *alloc_large(mm_arena_t *arena, uint32_t size)
+{
+    chunk_t *c;
+
+    if (size > UINT32_MAX - CHUNK_HDR ||
+	(c = new_chunk(CHUNK_HDR + size)) == NULL)
+	return NULL;
+    c->next = arena->large;
+    arena->large = c;
+    return (char *)c + CHUNK_HDR;
+}
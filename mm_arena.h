@@ -0,0 +1,28 @@
+/*
+ * mm_arena.h - region allocator on top of the mm heap
+ *
+ * An arena hands out memory by bumping a pointer through chunks that
+ * it gets from mm_malloc. Individual allocations are never freed;
+ * instead mm_arena_reset() discards everything at once and keeps the
+ * chunks for the next round, and mm_arena_destroy() returns them to mm.
+ */
+#ifndef __MM_ARENA_H_
+#define __MM_ARENA_H_
+
+#include <stdint.h>
+
+typedef struct mm_arena mm_arena_t;
+
+/* Create an arena that grows in chunks of chunk_size bytes (0 = default) */
+mm_arena_t *mm_arena_create(uint32_t chunk_size);
+
+/* Allocate size bytes, 8-byte aligned; NULL if mm is out of memory */
+void *mm_arena_alloc(mm_arena_t *arena, uint32_t size);
+
+/* Release every allocation made since the arena was created or reset */
+void mm_arena_reset(mm_arena_t *arena);
+
+/* Release every allocation and the arena itself */
+void mm_arena_destroy(mm_arena_t *arena);
+
+#endif /* __MM_ARENA_H_ */
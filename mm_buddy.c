@@ -0,0 +1,415 @@
+/*
+ * mm_buddy.c - binary buddy allocator over the memlib heap
+ *
+ * Every block is 2^k bytes for an order k between MIN_ORDER and the
+ * root order, and starts at an offset from the heap base that is a
+ * multiple of its size. The buddy of a block of order k is the other
+ * half of the block of order k + 1 that holds it, at the offset with
+ * bit k flipped. Blocks have no headers or footers: outside the heap,
+ * a byte map holds the order of the block that starts at each
+ * MIN_ORDER unit of the heap, and a bitmap has one bit per unit, set
+ * where a free block starts, so freeing a block checks its buddy with
+ * one bit and one byte and merges up in O(log n). Free blocks are kept
+ * on one doubly-linked list per order, and a mask of the non-empty
+ * lists finds the smallest free block that fits with a single bit scan.
+ *
+ * The heap is always one root block. When no free block is large
+ * enough, the heap doubles: the new half is freed as the buddy of the
+ * old root, and merges with it if the old root was entirely free.
+ *
+ * Requests are rounded up to a power of two. A power-of-two request
+ * fills its block exactly; other sizes trade utilization for
+ * constant-time placement. The allocator links into mdriver-buddy and
+ * engine_buddy.so for comparison with the boundary-tag allocator in
+ * mm.c. mm_memalign and mm_realloc_aligned are not provided.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "config.h"
+
+team_t team = {
+    /* Team name */
+    "SZY",
+    /* First member's full name */
+    "Szymon Ligas",
+    /* First member's email address */
+    "szli6792@colorado.edu",
+    /* Second member's full name (leave blank if none) */
+    "",
+    /* Second member's email address (leave blank if none) */
+    ""
+};
+
+#define MIN_ORDER 4         /* 16 bytes: prev/next links */
+#define MAX_ORDER 30        /* mem_sbrk takes an int */
+#define INIT_ORDER 12       /* size of the first root block (4KB) */
+#define MAX_REQUEST (1u << MAX_ORDER)
+
+#define MAP_BITS ((size_t)MAX_HEAP >> MIN_ORDER)
+
+/* Free list links, in the payload of a free block */
+typedef struct linkedlist {
+    struct linkedlist *prev;
+    struct linkedlist *next;
+} linkedlist;
+
+static char *heap_base;     /* first byte of the root block */
+static int root_order = -1; /* the heap is 2^root_order bytes; -1 if empty */
+static linkedlist *freelist[MAX_ORDER + 1];
+static uint32_t nonempty;   /* bit k set iff freelist[k] != NULL */
+static uint64_t freemap[MAP_BITS / 64 + 1];
+static uint8_t ordermap[MAP_BITS];
+
+/* Block touched by the most recent operation, for the sampled check */
+static void *last_bp;
+
+/* Given block bp, its offset in the heap and its MIN_ORDER unit */
+#define OFFSET(bp) ((size_t)((char *)(bp) - heap_base))
+#define MAP_BIT(bp) (OFFSET(bp) >> MIN_ORDER)
+
+/* The buddy of the block of order k at bp */
+#define BUDDY(bp, k) (heap_base + (OFFSET(bp) ^ ((size_t)1 << (k))))
+
+/* Order of the block at bp, from the order map */
+#define GET_ORDER(bp) (ordermap[MAP_BIT(bp)])
+#define PUT_ORDER(bp, k) (ordermap[MAP_BIT(bp)] = (uint8_t)(k))
+
+/* Free block bitmap */
+#define IS_FREE(bp) ((freemap[MAP_BIT(bp) / 64] >> (MAP_BIT(bp) % 64)) & 1)
+#define SET_FREE(bp) (freemap[MAP_BIT(bp) / 64] |= (uint64_t)1 << (MAP_BIT(bp) % 64))
+#define CLEAR_FREE(bp) (freemap[MAP_BIT(bp) / 64] &= ~((uint64_t)1 << (MAP_BIT(bp) % 64)))
+
+/* function prototypes */
+static int order_of(uint32_t size);
+static int grow_heap(int k);
+static void *coalesce(void *bp, int k);
+static void list_insert(void *bp, int k);
+static void list_remove(void *bp);
+static int check_block(void *bp);
+
+/*
+ * mm_init - start over with an empty heap; the root block is made by
+ *    the first allocation
+ */
+int mm_init(void)
+{
+    /* Only the bits of the previous heap can be set */
+    if (root_order >= 0)
+	memset(freemap, 0,
+	       (((size_t)1 << root_order >> MIN_ORDER) + 63) / 64 * sizeof(uint64_t));
+    memset(freelist, 0, sizeof(freelist));
+    nonempty = 0;
+    heap_base = NULL;
+    root_order = -1;
+    last_bp = NULL;
+    return 0;
+}
+
+/*
+ * order_of - smallest order whose blocks hold size payload bytes
+ */
+static int order_of(uint32_t size)
+{
+    int k = size > 1 ? 32 - __builtin_clz(size - 1) : 0;
+
+    return k < MIN_ORDER ? MIN_ORDER : k;
+}
+
+/*
+ * grow_heap - double the heap until there is a free block of order k
+ *    or more. Returns 0 on success, -1 if memlib runs out.
+ */
+static int grow_heap(int k)
+{
+    void *bp;
+
+    if (root_order < 0) {
+	int order = k > INIT_ORDER ? k : INIT_ORDER;
+
+	if ((heap_base = mem_sbrk(1 << order)) == (void *)-1)
+	    return -1;
+	root_order = order;
+	list_insert(heap_base, order);
+	return 0;
+    }
+    while (root_order < MAX_ORDER && (size_t)2 << root_order <= MAX_HEAP) {
+	if ((bp = mem_sbrk(1 << root_order)) == (void *)-1)
+	    return -1;
+	root_order++;
+	bp = coalesce(bp, root_order - 1);
+	if ((int)GET_ORDER(bp) >= k)
+	    return 0;
+    }
+    return -1;
+}
+
+/*
+ * mm_malloc - take the smallest free block that fits and split it down
+ *    to the order of the request, freeing the upper halves
+ */
+void *mm_malloc(uint32_t size)
+{
+    void *bp;
+    int j, k;
+
+    if (size == 0 || size > MAX_REQUEST)
+	return NULL;
+    k = order_of(size);
+    if ((nonempty >> k) == 0 && grow_heap(k) < 0)
+	return NULL;
+
+    j = __builtin_ctz(nonempty >> k) + k;
+    bp = freelist[j];
+    list_remove(bp);
+    while (j > k) {
+	j--;
+	list_insert((char *)bp + ((size_t)1 << j), j);
+    }
+    PUT_ORDER(bp, k);
+    last_bp = bp;
+    return bp;
+}
+
+/*
+ * mm_malloc_hint - lifetime hints do not change buddy placement
+ */
+void *mm_malloc_hint(uint32_t size, int hint)
+{
+    (void)hint;
+    return mm_malloc(size);
+}
+
+/*
+ * mm_free - free a block, merging it with its buddy for as long as the
+ *    buddy is free and whole
+ */
+void mm_free(void *bp)
+{
+    if (bp == NULL)
+	return;
+    last_bp = coalesce(bp, GET_ORDER(bp));
+}
+
+/*
+ * coalesce - put the block of order k at bp on a free list after
+ *    merging it with its free buddies. Returns the merged block.
+ */
+static void *coalesce(void *bp, int k)
+{
+    while (k < root_order) {
+	char *buddy = BUDDY(bp, k);
+
+	/* A buddy that is split has a smaller order at its start */
+	if (!IS_FREE(buddy) || (int)GET_ORDER(buddy) != k)
+	    break;
+	list_remove(buddy);
+	if (buddy < (char *)bp)
+	    bp = buddy;
+	k++;
+    }
+    list_insert(bp, k);
+    return bp;
+}
+
+/*
+ * mm_realloc - keep the block when the new size fits its order, giving
+ *    back the upper halves when it shrinks; grow it in place when the
+ *    buddies above it are free, and move it otherwise
+ */
+void *mm_realloc(void *ptr, uint32_t size)
+{
+    void *newp;
+    int j, k, need;
+
+    if (ptr == NULL)
+	return mm_malloc(size);
+    if (size == 0) {
+	mm_free(ptr);
+	return NULL;
+    }
+    if (size > MAX_REQUEST)
+	return NULL;
+
+    k = GET_ORDER(ptr);
+    need = order_of(size);
+    last_bp = ptr;
+    if (need <= k) {
+	while (k > need) {
+	    k--;
+	    list_insert((char *)ptr + ((size_t)1 << k), k);
+	}
+	PUT_ORDER(ptr, k);
+	return ptr;
+    }
+
+    /* In place only as the lower half, with a whole free buddy at each
+       order up to the one needed */
+    for (j = k; j < need && j < root_order; j++) {
+	char *buddy = BUDDY(ptr, j);
+
+	if ((OFFSET(ptr) >> j) & 1 || !IS_FREE(buddy) ||
+	    (int)GET_ORDER(buddy) != j)
+	    break;
+    }
+    if (j == need) {
+	for (j = k; j < need; j++)
+	    list_remove(BUDDY(ptr, j));
+	PUT_ORDER(ptr, need);
+	return ptr;
+    }
+
+    if ((newp = mm_malloc(size)) == NULL)
+	return NULL;
+    memcpy(newp, ptr, (size_t)1 << k);
+    mm_free(ptr);
+    return newp;
+}
+
+/*
+ * mm_usable_size - number of payload bytes available in block bp
+ */
+uint32_t mm_usable_size(void *bp)
+{
+    return 1u << GET_ORDER(bp);
+}
+
+/*
+ * list_insert - mark the block of order k at bp free and push it on
+ *    the free list of its order
+ */
+static void list_insert(void *bp, int k)
+{
+    linkedlist *lp = bp;
+
+    PUT_ORDER(bp, k);
+    SET_FREE(bp);
+    lp->prev = NULL;
+    lp->next = freelist[k];
+    if (freelist[k] != NULL)
+	freelist[k]->prev = lp;
+    freelist[k] = lp;
+    nonempty |= 1u << k;
+}
+
+/*
+ * list_remove - take a free block off its list and mark it allocated
+ */
+static void list_remove(void *bp)
+{
+    linkedlist *lp = bp;
+    int k = GET_ORDER(bp);
+
+    CLEAR_FREE(bp);
+    if (lp->prev != NULL)
+	lp->prev->next = lp->next;
+    else if ((freelist[k] = lp->next) == NULL)
+	nonempty &= ~(1u << k);
+    if (lp->next != NULL)
+	lp->next->prev = lp->prev;
+}
+
+/*
+ * Heap consistency checker
+ *
+ * MM_CHECK_SAMPLE checks the block of the most recent operation and its
+ * buddy, MM_CHECK_FULL walks every block, and MM_CHECK_LISTS also
+ * checks the free lists and the bitmap against the walk. Returns 0 if
+ * no problem was found, -1 otherwise.
+ */
+
+/*
+ * check_block - verify one block's order, placement, and that it is
+ *    not a free block whose free buddy escaped merging
+ */
+static int check_block(void *bp)
+{
+    int k = GET_ORDER(bp);
+
+    if (k < MIN_ORDER || k > root_order) {
+	fprintf(stderr, "mm_checkheap: block %p has bad order %d\n", bp, k);
+	return -1;
+    }
+    if (OFFSET(bp) & (((size_t)1 << k) - 1)) {
+	fprintf(stderr, "mm_checkheap: block %p of order %d is misplaced\n",
+		bp, k);
+	return -1;
+    }
+    if (IS_FREE(bp) && k < root_order && IS_FREE(BUDDY(bp, k)) &&
+	(int)GET_ORDER(BUDDY(bp, k)) == k) {
+	fprintf(stderr, "mm_checkheap: free buddies %p and %p were not "
+		"merged\n", bp, (void *)BUDDY(bp, k));
+	return -1;
+    }
+    return 0;
+}
+
+int mm_checkheap(int level)
+{
+    size_t heapsize, off, map_free = 0;
+    long free_blocks = 0, listed = 0;
+    linkedlist *lp;
+    int k;
+
+    if (root_order < 0)
+	return 0;
+    heapsize = (size_t)1 << root_order;
+    if ((char *)mem_heap_hi() + 1 != heap_base + heapsize) {
+	fprintf(stderr, "mm_checkheap: heap is %zu bytes, root block %zu\n",
+		(size_t)((char *)mem_heap_hi() + 1 - heap_base), heapsize);
+	return -1;
+    }
+
+    if (level == MM_CHECK_SAMPLE) {
+	if (last_bp == NULL || check_block(last_bp) < 0)
+	    return last_bp == NULL ? 0 : -1;
+	k = GET_ORDER(last_bp);
+	return k < root_order ? check_block(BUDDY(last_bp, k)) : 0;
+    }
+
+    for (off = 0; off < heapsize; ) {
+	void *bp = heap_base + off;
+
+	if (check_block(bp) < 0)
+	    return -1;
+	if (IS_FREE(bp))
+	    free_blocks++;
+	off += (size_t)1 << GET_ORDER(bp);
+    }
+    if (off != heapsize) {
+	fprintf(stderr, "mm_checkheap: heap walk ended at offset %zu, not "
+		"%zu\n", off, heapsize);
+	return -1;
+    }
+    if (level < MM_CHECK_LISTS)
+	return 0;
+
+    for (k = 0; k <= MAX_ORDER; k++) {
+	if ((freelist[k] != NULL) != ((nonempty >> k) & 1)) {
+	    fprintf(stderr, "mm_checkheap: non-empty mask is wrong for order "
+		    "%d\n", k);
+	    return -1;
+	}
+	for (lp = freelist[k]; lp != NULL; lp = lp->next) {
+	    if ((char *)lp < heap_base || (char *)lp >= heap_base + heapsize ||
+		!IS_FREE(lp) || (int)GET_ORDER(lp) != k ||
+		(lp->next != NULL && lp->next->prev != lp)) {
+		fprintf(stderr, "mm_checkheap: bad block %p on free list %d\n",
+			(void *)lp, k);
+		return -1;
+	    }
+	    listed++;
+	}
+    }
+    for (off = 0; off <= (heapsize >> MIN_ORDER) / 64; off++)
+	map_free += __builtin_popcountll(freemap[off]);
+    if (listed != free_blocks || (long)map_free != free_blocks) {
+	fprintf(stderr, "mm_checkheap: %ld free blocks in the heap, %ld on "
+		"the lists, %zu in the bitmap\n", free_blocks, listed, map_free);
+	return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * mm_engine.h - interface to allocator engines that mdriver loads at
+ *               run time with -e
+ *
+ * An engine is a shared object that exports a const mm_engine_t named
+ * mm_engine (MM_ENGINE_SYMBOL). mdriver replays each trace through
+ * the engine's entry points, in the same way as it replays the
+ * statically linked mm.c, and prints the results side by side. Build
+ * engines with -fPIC -fvisibility=hidden so that the allocator inside
+ * does not clash with the copy linked into mdriver.
+ */
+#ifndef __MM_ENGINE_H_
+#define __MM_ENGINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MM_ENGINE_VERSION 3
+#define MM_ENGINE_SYMBOL "mm_engine"
+#define MM_ENGINE_EXPORT __attribute__((visibility("default")))
+
+/* Engine flags */
+#define MM_ENGINE_THREADSAFE 0x1 /* entry points may be called concurrently */
+
+typedef struct {
+    int version;                /* MM_ENGINE_VERSION */
+    const char *name;           /* column heading in mdriver's tables */
+    unsigned flags;             /* MM_ENGINE_* flags */
+
+    /* Start over with an empty heap; called before every replay.
+       Returns 0 on success, -1 on error */
+    int (*init)(void);
+    void *(*malloc)(uint32_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, uint32_t size);
+
+    /* Optional statistics; NULL if the engine cannot provide them */
+    size_t (*heapsize)(void);   /* peak bytes of heap since init */
+    int (*checkheap)(int level); /* as mm_checkheap() */
+
+    /* Optional extent of the heap, first and last byte, as
+       mem_heap_lo() and mem_heap_hi(); NULL if the heap is not one
+       contiguous region. mdriver checks that payloads lie inside it */
+    void *(*heap_lo)(void);
+    void *(*heap_hi)(void);
+} mm_engine_t;
+
+#endif /* __MM_ENGINE_H_ */
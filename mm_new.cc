@@ -0,0 +1,109 @@
+/*
+ * mm_new.cc - replace the global operator new and delete with the mm
+ *             package
+ *
+ * Linking this file into a program sends every C++ heap allocation,
+ * including the sized and over-aligned forms, to mm_malloc and
+ * mm_memalign. The heap is created on first use, which may be before
+ * main() runs, and a lock serializes calls since mm.c is not
+ * thread-safe. This file owns the heap: a program linked with it must
+ * not call mem_init() or mm_init() itself, and the adapters in
+ * mm_allocator.h, which do not take the lock, must not race with
+ * operator new and delete on other threads.
+ */
+#include <mutex>
+#include <new>
+
+#include "mm_allocator.h"
+
+namespace {
+
+std::mutex lock;
+bool initialized;
+
+void *mm_new(std::size_t size, std::size_t align)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!initialized) {
+        mem_init();
+        if (mm_init() < 0)
+            throw std::bad_alloc();
+        initialized = true;
+    }
+    return mm_detail::allocate(size, align);
+}
+
+void *mm_new_nothrow(std::size_t size, std::size_t align) noexcept
+{
+    try {
+        return mm_new(size, align);
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void mm_delete(void *p) noexcept
+{
+    if (p == nullptr)
+        return;
+    std::lock_guard<std::mutex> guard(lock);
+    mm_free(p);
+}
+
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    return mm_new(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new[](std::size_t size)
+{
+    return mm_new(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return mm_new_nothrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return mm_new_nothrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(std::size_t size, std::align_val_t align)
+{
+    return mm_new(size, static_cast<std::size_t>(align));
+}
+
+void *operator new[](std::size_t size, std::align_val_t align)
+{
+    return mm_new(size, static_cast<std::size_t>(align));
+}
+
+void *operator new(std::size_t size, std::align_val_t align,
+                   const std::nothrow_t &) noexcept
+{
+    return mm_new_nothrow(size, static_cast<std::size_t>(align));
+}
+
+void *operator new[](std::size_t size, std::align_val_t align,
+                     const std::nothrow_t &) noexcept
+{
+    return mm_new_nothrow(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void *p) noexcept { mm_delete(p); }
+void operator delete[](void *p) noexcept { mm_delete(p); }
+void operator delete(void *p, std::size_t) noexcept { mm_delete(p); }
+void operator delete[](void *p, std::size_t) noexcept { mm_delete(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { mm_delete(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { mm_delete(p); }
+void operator delete(void *p, std::align_val_t) noexcept { mm_delete(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { mm_delete(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { mm_delete(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { mm_delete(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { mm_delete(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { mm_delete(p); }
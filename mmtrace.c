@@ -0,0 +1,464 @@
+/*
+ * mmtrace.c - allocation trace recorder layered over the mm package
+ *
+ * Each call is given a global sequence number and appended to a buffer
+ * owned by the calling thread, so the recording path does no I/O. Full
+ * buffers are pushed onto a lock-free stack that a writer thread drains
+ * into a binary spool file next to the output. mmtrace_close() collects
+ * the partial buffers, sorts the spooled records back into call order
+ * and writes the .rep file.
+ *
+ * Recording itself is single-threaded, like mm.c: the sequence and id
+ * counters and the pointer map are not locked, so callers on several
+ * threads must serialize the mmtrace_* calls (see mmtrace.h). Only the
+ * hand-off to the writer thread is synchronized.
+ *
+ * Block ids are handed out in allocation order and never reused, which
+ * is what mdriver expects: ids run from 0 to num_ids - 1. A realloc
+ * keeps the id of the block it resizes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+
+#include "mm.h"
+#include "mmtrace.h"
+#include "traceio.h"
+
+#define BUFOPS 4096          /* records per thread buffer */
+#define FLUSH_NSECS 50000000 /* writer wakes up at least every 50 ms */
+#define MAP_MINCAP 1024      /* initial size of the pointer -> id map */
+
+/* One recorded call */
+typedef struct {
+    unsigned long seq; /* position in the global call order */
+    int type;          /* REP_ALLOC, REP_FREE or REP_REALLOC */
+    int index;         /* block id */
+    uint32_t size;     /* request size (0 for frees) */
+} record_t;
+
+/* A batch of records filled by one thread */
+typedef struct buffer {
+    struct buffer *next; /* link on the full-buffer stack */
+    int n;               /* records in use */
+    record_t recs[BUFOPS];
+} buffer_t;
+
+/* Per-thread state, kept on a registry so close can find partial buffers */
+typedef struct tstate {
+    buffer_t *buf;
+    struct tstate *next;
+} tstate_t;
+
+/* Open-addressing map from live payload pointers to block ids */
+typedef struct {
+    void *ptr;
+    int id;
+} slot_t;
+
+#define EMPTY NULL
+#define TOMBSTONE ((void *)1)
+
+/* private variables */
+static int recording;                     /* is a recording open? */
+static char *rep_path;                    /* where the .rep goes */
+static char *spool_path;                  /* binary records, unordered */
+static FILE *spool;
+static unsigned long next_seq;
+static int next_id;
+
+static _Atomic(buffer_t *) full_bufs;     /* buffers waiting for the writer */
+static _Atomic(tstate_t *) threads;       /* every thread that recorded */
+static __thread tstate_t *self;
+
+static pthread_t writer;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wake = PTHREAD_COND_INITIALIZER;
+static int writer_stop;
+static int write_failed;
+
+static slot_t *map;
+static size_t map_cap, map_used, map_dead; /* live entries, tombstones */
+
+/* function prototypes */
+static void record(int type, int index, uint32_t size);
+static void push_full(buffer_t *buf);
+static void drain(void);
+static void *writer_main(void *arg);
+static int map_insert(void *ptr, int id);
+static int map_remove(void *ptr);
+static int by_seq(const void *a, const void *b);
+
+/*
+ * mmtrace_open - start a new recording
+ */
+int mmtrace_open(const char *path)
+{
+    size_t len = strlen(path);
+
+    if (recording)
+	return -1;
+    if ((rep_path = strdup(path)) == NULL ||
+	(spool_path = (char *)malloc(len + sizeof(".spool"))) == NULL)
+	goto fail;
+    memcpy(spool_path, path, len);
+    strcpy(spool_path + len, ".spool");
+    if ((spool = fopen(spool_path, "w+b")) == NULL)
+	goto fail;
+
+    map_cap = MAP_MINCAP;
+    map_used = map_dead = 0;
+    if ((map = (slot_t *)calloc(map_cap, sizeof(slot_t))) == NULL)
+	goto fail;
+
+    next_seq = 0;
+    next_id = 0;
+    writer_stop = 0;
+    write_failed = 0;
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0)
+	goto fail;
+    recording = 1;
+    return 0;
+
+ fail:
+    if (spool != NULL) {
+	fclose(spool);
+	remove(spool_path);
+	spool = NULL;
+    }
+    free(map);
+    free(spool_path);
+    free(rep_path);
+    map = NULL;
+    spool_path = rep_path = NULL;
+    return -1;
+}
+
+/*
+ * mmtrace_close - stop recording and write the .rep file
+ */
+int mmtrace_close(void)
+{
+    tstate_t *t;
+    record_t *recs = NULL;
+    rep_t *rep = NULL;
+    long nrecs, i;
+    int status = -1;
+
+    if (!recording)
+	return -1;
+    recording = 0;
+
+    /* Hand the writer every partially filled buffer, then stop it */
+    for (t = atomic_load(&threads); t != NULL; t = t->next) {
+	if (t->buf != NULL)
+	    push_full(t->buf);
+	t->buf = NULL;
+    }
+    pthread_mutex_lock(&writer_lock);
+    writer_stop = 1;
+    pthread_cond_signal(&writer_wake);
+    pthread_mutex_unlock(&writer_lock);
+    pthread_join(writer, NULL);
+
+    /* Read the spool back and restore call order */
+    if (write_failed || fflush(spool) != 0 || fseek(spool, 0, SEEK_END) != 0)
+	goto out;
+    nrecs = ftell(spool) / (long)sizeof(record_t);
+    rewind(spool);
+    if ((recs = (record_t *)malloc((nrecs + 1) * sizeof(record_t))) == NULL ||
+	fread(recs, sizeof(record_t), nrecs, spool) != (size_t)nrecs)
+	goto out;
+    qsort(recs, nrecs, sizeof(record_t), by_seq);
+
+    if ((rep = rep_new()) == NULL)
+	goto out;
+    for (i = 0; i < nrecs; i++)
+	if (rep_append(rep, (rep_type_t)recs[i].type, recs[i].index,
+		       recs[i].size) < 0)
+	    goto out;
+    rep_fixup(rep);
+    status = rep_write(rep_path, rep);
+
+ out:
+    rep_free(rep);
+    free(recs);
+    fclose(spool);
+    remove(spool_path);
+    spool = NULL;
+    free(map);
+    free(spool_path);
+    free(rep_path);
+    map = NULL;
+    spool_path = rep_path = NULL;
+    return status;
+}
+
+/*
+ * mmtrace_malloc - mm_malloc, recording a new block id
+ */
+void *mmtrace_malloc(uint32_t size)
+{
+    void *p = mm_malloc(size);
+
+    if (recording && p != NULL) {
+	int id = next_id++;
+
+	if (map_insert(p, id) == 0)
+	    record(REP_ALLOC, id, size);
+    }
+    return p;
+}
+
+/*
+ * mmtrace_memalign - mm_memalign, recorded as a plain allocation since
+ *    .rep files carry no alignment
+ */
+void *mmtrace_memalign(size_t align, uint32_t size)
+{
+    void *p = mm_memalign(align, size);
+
+    if (recording && p != NULL) {
+	int id = next_id++;
+
+	if (map_insert(p, id) == 0)
+	    record(REP_ALLOC, id, size);
+    }
+    return p;
+}
+
+/*
+ * mmtrace_free - mm_free, recording the free if the block was recorded
+ */
+void mmtrace_free(void *ptr)
+{
+    if (recording && ptr != NULL) {
+	int id = map_remove(ptr);
+
+	if (id >= 0)
+	    record(REP_FREE, id, 0);
+    }
+    mm_free(ptr);
+}
+
+/*
+ * mmtrace_realloc - mm_realloc, keeping the block's id
+ */
+void *mmtrace_realloc(void *ptr, uint32_t size)
+{
+    return mmtrace_realloc_aligned(ptr, 0, size);
+}
+
+/*
+ * mmtrace_realloc_aligned - mm_realloc_aligned, keeping the block's id.
+ *    Blocks allocated before the recording started are recorded as new
+ *    allocations, and a resize to 0 as a free.
+ */
+void *mmtrace_realloc_aligned(void *ptr, size_t align, uint32_t size)
+{
+    void *newp;
+    int id;
+
+    if (ptr == NULL)
+	return mmtrace_memalign(align, size);
+    if (size == 0) {
+	mmtrace_free(ptr);
+	return NULL;
+    }
+    if ((newp = mm_realloc_aligned(ptr, align, size)) == NULL || !recording)
+	return newp;
+
+    if ((id = map_remove(ptr)) >= 0) {
+	if (map_insert(newp, id) == 0)
+	    record(REP_REALLOC, id, size);
+    } else {
+	id = next_id++;
+	if (map_insert(newp, id) == 0)
+	    record(REP_ALLOC, id, size);
+    }
+    return newp;
+}
+
+/*
+ * record - append one call to the calling thread's buffer
+ */
+static void record(int type, int index, uint32_t size)
+{
+    buffer_t *buf;
+    record_t *r;
+
+    if (self == NULL) {
+	if ((self = (tstate_t *)calloc(1, sizeof(tstate_t))) == NULL)
+	    return;
+	self->next = atomic_load(&threads);
+	while (!atomic_compare_exchange_weak(&threads, &self->next, self))
+	    ;
+    }
+    if ((buf = self->buf) == NULL) {
+	if ((buf = (buffer_t *)malloc(sizeof(buffer_t))) == NULL)
+	    return;
+	buf->n = 0;
+	self->buf = buf;
+    }
+
+    r = &buf->recs[buf->n++];
+    r->seq = next_seq++;
+    r->type = type;
+    r->index = index;
+    r->size = size;
+
+    if (buf->n == BUFOPS) {
+	self->buf = NULL;
+	push_full(buf);
+	pthread_cond_signal(&writer_wake);
+    }
+}
+
+/*
+ * push_full - put a buffer on the stack the writer drains
+ */
+static void push_full(buffer_t *buf)
+{
+    buf->next = atomic_load(&full_bufs);
+    while (!atomic_compare_exchange_weak(&full_bufs, &buf->next, buf))
+	;
+}
+
+/*
+ * drain - write out and release every buffer on the full stack.
+ *    Taking the whole stack with one exchange avoids ABA problems.
+ */
+static void drain(void)
+{
+    buffer_t *buf = atomic_exchange(&full_bufs, NULL);
+
+    while (buf != NULL) {
+	buffer_t *next = buf->next;
+
+	if (fwrite(buf->recs, sizeof(record_t), buf->n, spool) != (size_t)buf->n)
+	    write_failed = 1;
+	free(buf);
+	buf = next;
+    }
+}
+
+/*
+ * writer_main - background thread that moves full buffers to the spool
+ */
+static void *writer_main(void *arg)
+{
+    struct timespec deadline;
+    int stop;
+
+    (void)arg;
+    do {
+	pthread_mutex_lock(&writer_lock);
+	if (!writer_stop) {
+	    clock_gettime(CLOCK_REALTIME, &deadline);
+	    deadline.tv_nsec += FLUSH_NSECS;
+	    if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	    }
+	    pthread_cond_timedwait(&writer_wake, &writer_lock, &deadline);
+	}
+	stop = writer_stop;
+	pthread_mutex_unlock(&writer_lock);
+	drain();
+    } while (!stop);
+    return NULL;
+}
+
+/*
+ * map_hash - slot index for a payload pointer
+ */
+static inline size_t map_hash(void *ptr)
+{
+    return (size_t)(((uintptr_t)ptr >> 3) * 0x9E3779B97F4A7C15ULL) & (map_cap - 1);
+}
+
+/*
+ * map_rehash - rehash into a table of new_cap slots, dropping tombstones.
+ *    Returns 0 on success, -1 if out of memory.
+ */
+static int map_rehash(size_t new_cap)
+{
+    slot_t *old = map;
+    size_t old_cap = map_cap, i;
+
+    if ((map = (slot_t *)calloc(new_cap, sizeof(slot_t))) == NULL) {
+	map = old;
+	return -1;
+    }
+    map_cap = new_cap;
+    map_used = map_dead = 0;
+    for (i = 0; i < old_cap; i++)
+	if (old[i].ptr != EMPTY && old[i].ptr != TOMBSTONE)
+	    map_insert(old[i].ptr, old[i].id);
+    free(old);
+    return 0;
+}
+
+/*
+ * map_insert - remember that ptr holds block id. Stops the recording
+ *    and returns -1 if the map cannot grow.
+ */
+static int map_insert(void *ptr, int id)
+{
+    size_t i, new_cap;
+
+    /* Under malloc/free churn the table fills with tombstones, not live
+       entries. Sweep them out at the same size while the live set is
+       small, so the table follows the live set rather than the number
+       of allocations ever made. */
+    if (2 * (map_used + map_dead + 1) > map_cap) {
+	new_cap = (4 * (map_used + 1) <= map_cap) ? map_cap : 2 * map_cap;
+	if (map_rehash(new_cap) < 0) {
+	    fprintf(stderr, "mmtrace: out of memory, recording stopped\n");
+	    recording = 0;
+	    write_failed = 1;
+	    return -1;
+	}
+    }
+    for (i = map_hash(ptr); map[i].ptr != EMPTY && map[i].ptr != TOMBSTONE;
+	 i = (i + 1) & (map_cap - 1))
+	;
+    if (map[i].ptr == TOMBSTONE)
+	map_dead--;
+    map_used++;
+    map[i].ptr = ptr;
+    map[i].id = id;
+    return 0;
+}
+
+/*
+ * map_remove - forget ptr and return its block id, or -1 if unknown
+ */
+static int map_remove(void *ptr)
+{
+    size_t i;
+
+    for (i = map_hash(ptr); map[i].ptr != EMPTY; i = (i + 1) & (map_cap - 1))
+	if (map[i].ptr == ptr) {
+	    map[i].ptr = TOMBSTONE;
+	    map_used--;
+	    map_dead++;
+	    return map[i].id;
+	}
+    return -1;
+}
+
+/*
+ * by_seq - qsort comparator restoring call order
+ */
+static int by_seq(const void *a, const void *b)
+{
+    unsigned long x = ((const record_t *)a)->seq;
+    unsigned long y = ((const record_t *)b)->seq;
+
+    return (x > y) - (x < y);
+}
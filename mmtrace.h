@@ -0,0 +1,38 @@
+/*
+ * mmtrace.h - record mm_malloc/mm_free/mm_realloc calls as a .rep trace
+ */
+#ifndef __MMTRACE_H_
+#define __MMTRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Start recording to the .rep file at path. Returns 0 on success,
+ * -1 if a recording is already in progress or the spool file or
+ * writer thread could not be created.
+ */
+int mmtrace_open(const char *path);
+
+/*
+ * Stop recording and write the .rep file, with num_ids and num_ops
+ * fixed up to match what was recorded. Call it once the application
+ * threads have stopped allocating. Returns 0 on success, -1 on error.
+ */
+int mmtrace_close(void);
+
+/*
+ * Drop-in replacements for mm_malloc, mm_free and mm_realloc. When no
+ * recording is open they cost one extra branch. Like mm.c itself they
+ * are not thread-safe: callers on several threads must serialize calls
+ * with a lock of their own, which also orders the recorded ops.
+ */
+void *mmtrace_malloc(uint32_t size);
+void mmtrace_free(void *ptr);
+void *mmtrace_realloc(void *ptr, uint32_t size);
+
+/* The same for mm_memalign and mm_realloc_aligned */
+void *mmtrace_memalign(size_t align, uint32_t size);
+void *mmtrace_realloc_aligned(void *ptr, size_t align, uint32_t size);
+
+#endif /* __MMTRACE_H_ */
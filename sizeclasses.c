@@ -0,0 +1,262 @@
+/*
+ * sizeclasses.c - choose mm_malloc size classes from trace profiles
+ *
+ * Builds the histogram of alloc and realloc request sizes in the given
+ * .rep files and picks k size classes for requests of up to -m bytes
+ * that minimize the expected internal fragmentation: the bytes a
+ * request is rounded up by, averaged over the histogram. Requests are
+ * first rounded to the 8-byte alignment mm_malloc needs anyway, and
+ * that part of the waste is not counted. The choice is an optimal
+ * partition of the aligned sizes into k runs, each rounded up to its
+ * largest size, found by dynamic programming.
+ *
+ * The result is written as mm_sizeclasses.h (see that file) for mm.c
+ * to include. Classes that would not merge any sizes are left out.
+ *
+ * usage: sizeclasses [-k <classes>] [-m <max size>] [-o <header>]
+ *                    <trace.rep>...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "traceio.h"
+
+#define ALIGNMENT 8
+#define MIN_PAYLOAD 16                  /* mm_malloc's smallest payload */
+#define ALIGN(n) (((n) + (ALIGNMENT - 1)) & ~(ALIGNMENT - 1))
+
+/* function prototypes */
+static uint32_t aligned(uint32_t size);
+static int choose(int k);
+static int write_header(const char *path, char **traces, int ntraces);
+static void usage(void);
+
+/* Histogram of aligned request sizes up to max_size, by size / ALIGNMENT */
+static double *hist;
+static uint32_t max_size = 4096;
+static int nbins;
+
+/* The chosen classes: index of the largest bin in each run */
+static int *class_end;
+static int nclasses;
+
+int main(int argc, char **argv)
+{
+    const char *out = "mm_sizeclasses.h";
+    double total = 0, above = 0, after = 0;
+    int k = 16;
+    int c, i, j, t;
+
+    while ((c = getopt(argc, argv, "k:m:o:h")) != -1) {
+	switch (c) {
+	case 'k':
+	    k = atoi(optarg);
+	    break;
+	case 'm':
+	    max_size = strtoul(optarg, NULL, 0);
+	    break;
+	case 'o':
+	    out = optarg;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (optind == argc || k < 1 || max_size < MIN_PAYLOAD) {
+	usage();
+	exit(1);
+    }
+    max_size = ALIGN(max_size);
+    nbins = max_size / ALIGNMENT + 1;
+    if ((hist = (double *)calloc(nbins, sizeof(double))) == NULL ||
+	(class_end = (int *)malloc(k * sizeof(int))) == NULL) {
+	fprintf(stderr, "out of memory\n");
+	exit(1);
+    }
+
+    for (t = optind; t < argc; t++) {
+	rep_t *rep;
+
+	if ((rep = rep_read(argv[t])) == NULL)
+	    exit(1);
+	for (i = 0; i < rep->num_ops; i++) {
+	    rep_op_t *op = &rep->ops[i];
+
+	    if (op->type == REP_FREE || op->size == 0)
+		continue;
+	    total++;
+	    if (aligned(op->size) > max_size)
+		above++;
+	    else
+		hist[aligned(op->size) / ALIGNMENT]++;
+	}
+	rep_free(rep);
+    }
+    if (total == above) {
+	fprintf(stderr, "no requests of up to %u bytes\n", max_size);
+	exit(1);
+    }
+
+    nclasses = choose(k);
+
+    /* Report the expected rounding per request, alignment aside */
+    for (i = 0, j = 0; i < nbins; i++) {
+	if (hist[i] == 0)
+	    continue;
+	while (class_end[j] < i)
+	    j++;
+	after += hist[i] * (class_end[j] - i) * ALIGNMENT;
+    }
+    printf("%.0f requests, %.0f above %u bytes\n", total, above, max_size);
+    printf("%d classes: %.2f bytes of internal fragmentation per request\n",
+	   nclasses, after / total);
+
+    if (write_header(out, argv + optind, argc - optind) < 0) {
+	fprintf(stderr, "%s: write failed\n", out);
+	exit(1);
+    }
+    return 0;
+}
+
+/*
+ * aligned - the payload mm_malloc gives a request of size bytes
+ *    before size classes are applied
+ */
+static uint32_t aligned(uint32_t size)
+{
+    return size < MIN_PAYLOAD ? MIN_PAYLOAD : ALIGN(size);
+}
+
+/*
+ * choose - split the nonempty bins into at most k runs so that the
+ *    weighted distance from each bin to the end of its run is minimal.
+ *    The last run ends at the largest nonempty bin. Fills class_end and
+ *    returns the number of runs.
+ */
+static int choose(int k)
+{
+    int *bins, *from;
+    double *cnt, *sum, *cost, *prev;
+    int n = 0, i, j, r;
+
+    bins = (int *)malloc(nbins * sizeof(int));
+    for (i = 0; i < nbins; i++)
+	if (hist[i] > 0)
+	    bins[n++] = i;
+    if (k > n)
+	k = n;
+
+    /* Prefix sums of counts and of count * bin over the nonempty bins */
+    cnt = (double *)calloc(n + 1, sizeof(double));
+    sum = (double *)calloc(n + 1, sizeof(double));
+    for (i = 0; i < n; i++) {
+	cnt[i + 1] = cnt[i] + hist[bins[i]];
+	sum[i + 1] = sum[i] + hist[bins[i]] * bins[i];
+    }
+
+    /* cost[j] = least waste of bins 0..j-1 in r runs, the last ending
+       at bin j-1; from[r * (n + 1) + j] = where that last run starts */
+    cost = (double *)malloc((n + 1) * sizeof(double));
+    prev = (double *)malloc((n + 1) * sizeof(double));
+    from = (int *)malloc((size_t)(k + 1) * (n + 1) * sizeof(int));
+    for (j = 0; j <= n; j++)
+	prev[j] = (j == 0) ? 0 : 1e300;
+    for (r = 1; r <= k; r++) {
+	cost[0] = 1e300;
+	for (j = 1; j <= n; j++) {
+	    cost[j] = 1e300;
+	    for (i = r - 1; i < j; i++) {
+		/* run of bins i..j-1, all rounded up to bins[j-1] */
+		double c = prev[i] + (double)bins[j - 1] * (cnt[j] - cnt[i]) -
+		    (sum[j] - sum[i]);
+
+		if (c < cost[j]) {
+		    cost[j] = c;
+		    from[r * (n + 1) + j] = i;
+		}
+	    }
+	}
+	for (j = 0; j <= n; j++)
+	    prev[j] = cost[j];
+    }
+
+    /* Walk back from the last bin to recover the runs */
+    for (r = k, j = n; r > 0; r--) {
+	class_end[r - 1] = bins[j - 1];
+	j = from[r * (n + 1) + j];
+    }
+
+    free(bins);
+    free(cnt);
+    free(sum);
+    free(cost);
+    free(prev);
+    free(from);
+    return k;
+}
+
+/*
+ * write_header - write the classes that merge sizes as mm_sizeclasses.h
+ */
+static int write_header(const char *path, char **traces, int ntraces)
+{
+    FILE *fp;
+    int i, t;
+    uint32_t lo = 1;
+
+    if ((fp = fopen(path, "w")) == NULL)
+	return -1;
+    fprintf(fp, "/*\n"
+	    " * mm_sizeclasses.h - size classes for mm_malloc\n"
+	    " *\n"
+	    " * A request of lo..hi bytes is rounded up to a block with a payload of\n"
+	    " * size bytes, so that blocks freed by requests of nearby sizes can be\n"
+	    " * reused for each other. The table is sorted, its ranges do not\n"
+	    " * overlap, and it ends with a zero entry.\n"
+	    " *\n"
+	    " * Generated by ./sizeclasses from:\n");
+    for (t = 0; t < ntraces; t++)
+	fprintf(fp, " *     %s\n", traces[t]);
+    fprintf(fp, " */\n"
+	    "#ifndef __MM_SIZECLASSES_H_\n"
+	    "#define __MM_SIZECLASSES_H_\n"
+	    "\n"
+	    "#include <stdint.h>\n"
+	    "\n"
+	    "static const struct {\n"
+	    "    uint32_t lo, hi, size;\n"
+	    "} mm_sizeclasses[] = {\n");
+    for (i = 0; i < nclasses; i++) {
+	uint32_t size = class_end[i] * ALIGNMENT;
+
+	/* A run that only holds one aligned size needs no entry */
+	if (size > MIN_PAYLOAD && lo <= size - ALIGNMENT)
+	    fprintf(fp, "    {%u, %u, %u},\n", lo, size, size);
+	lo = size + 1;
+    }
+    fprintf(fp, "    {0, 0, 0}\n"
+	    "};\n"
+	    "\n"
+	    "#endif /* __MM_SIZECLASSES_H_ */\n");
+    if (ferror(fp)) {
+	fclose(fp);
+	return -1;
+    }
+    return fclose(fp);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: sizeclasses [-k <classes>] [-m <max size>] "
+	    "[-o <header>] <trace.rep>...\n");
+    fprintf(stderr, "\t-k <n>     Number of size classes (default 16).\n");
+    fprintf(stderr, "\t-m <n>     Largest request given a class "
+	    "(default 4096).\n");
+    fprintf(stderr, "\t-o <file>  Output header (default mm_sizeclasses.h).\n");
+}
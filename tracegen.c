@@ -0,0 +1,404 @@
+/*
+ * tracegen.c - generate synthetic .rep traces
+ *
+ * Writes a balanced trace of exactly -n requests whose live payload
+ * hovers around -L bytes. Block sizes are drawn from one of
+ *
+ *   uniform:LO:HI        uniform between LO and HI bytes
+ *   lognormal:MU:SIGMA   exp(N(MU, SIGMA)) bytes
+ *   zipf:S:MAX           8 * k bytes, k in 1..MAX/8 with P(k) ~ 1/k^S
+ *   bimodal:A:B:P        about A bytes with probability P, else about B
+ *
+ * and blocks die according to one of the lifetime models
+ *
+ *   exp                  exponentially distributed lifetimes
+ *   phase:LEN:FRAC       blocks die at the end of the LEN-request phase
+ *                        they were born in, except a FRAC share of
+ *                        survivors with long exponential lifetimes
+ *   lifo, fifo           the newest or the oldest live block is freed
+ *
+ * With -r PCT:GROWTH, PCT percent of the requests realloc a random live
+ * block to GROWTH times its size. The same options and -s seed always
+ * give the same trace. -b writes the binary format of traceio.h.
+ *
+ * usage: tracegen [-n <requests>] [-L <live bytes>] [-d <sizes>]
+ *                 [-l <lifetimes>] [-r <pct>:<growth>] [-m <max size>]
+ *                 [-w <weight>] [-s <seed>] [-b] <out.rep>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "traceio.h"
+
+typedef enum { UNIFORM, LOGNORMAL, ZIPF, BIMODAL } dist_t;
+typedef enum { EXP, PHASE, LIFO, FIFO } model_t;
+
+/* A pending free in the exp and phase models */
+typedef struct {
+    long death;   /* request number at which the block is freed */
+    int id;
+} death_t;
+
+/* Settings */
+static dist_t dist = LOGNORMAL;
+static double dist_arg[3] = {4, 1, 0};
+static model_t model = EXP;
+static long phase_len = 1000;
+static double survive = 0.1;
+static double realloc_pct = 0, growth = 1.5;
+static long max_size = 1 << 20;
+
+/* Generator state */
+static uint64_t rng;
+static double *zipf_cdf;
+static long zipf_n;
+static int *sizes;       /* current size of each id */
+static int *live, *pos;  /* live ids, and each id's index in live */
+static int num_live;
+static long live_bytes;
+static death_t *heap;    /* min-heap of pending frees */
+static int heap_len;
+static int *order;       /* ids in allocation order (lifo, fifo) */
+static long head, tail;
+
+/* function prototypes */
+static int parse_dist(const char *spec);
+static int parse_model(const char *spec);
+static double rnd(void);
+static int draw_size(void);
+static void heap_push(long death, int id);
+static int heap_pop(void);
+static int pick_victim(void);
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    long num_ops = 100000, target = 1 << 20;
+    unsigned long seed = 1;
+    int weight = 1, binary = 0;
+    double mean_size, mean_life;
+    rep_t *rep;
+    int c, i, next_id = 0;
+
+    while ((c = getopt(argc, argv, "n:L:d:l:r:m:w:s:bh")) != -1) {
+	switch (c) {
+	case 'n':
+	    num_ops = strtol(optarg, NULL, 0);
+	    break;
+	case 'L':
+	    target = strtol(optarg, NULL, 0);
+	    break;
+	case 'd':
+	    if (parse_dist(optarg) < 0) {
+		fprintf(stderr, "tracegen: bad size distribution %s\n", optarg);
+		exit(1);
+	    }
+	    break;
+	case 'l':
+	    if (parse_model(optarg) < 0) {
+		fprintf(stderr, "tracegen: bad lifetime model %s\n", optarg);
+		exit(1);
+	    }
+	    break;
+	case 'r':
+	    if (sscanf(optarg, "%lf:%lf", &realloc_pct, &growth) < 1) {
+		fprintf(stderr, "tracegen: bad realloc pattern %s\n", optarg);
+		exit(1);
+	    }
+	    break;
+	case 'm':
+	    max_size = strtol(optarg, NULL, 0);
+	    break;
+	case 'w':
+	    weight = atoi(optarg);
+	    break;
+	case 's':
+	    seed = strtoul(optarg, NULL, 0);
+	    break;
+	case 'b':
+	    binary = 1;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (optind != argc - 1 || num_ops < 2 || num_ops > 0x3fffffff ||
+	target < 1 || max_size < 1) {
+	usage();
+	exit(1);
+    }
+    rng = seed * 0x9e3779b97f4a7c15ULL + 1;
+
+    if (dist == ZIPF) {
+	double sum = 0;
+	long k;
+
+	zipf_n = (long)dist_arg[1] / 8 > 0 ? (long)dist_arg[1] / 8 : 1;
+	if ((zipf_cdf = malloc(zipf_n * sizeof(double))) == NULL) {
+	    fprintf(stderr, "tracegen: out of memory\n");
+	    exit(1);
+	}
+	for (k = 0; k < zipf_n; k++)
+	    zipf_cdf[k] = (sum += pow(k + 1, -dist_arg[0]));
+	for (k = 0; k < zipf_n; k++)
+	    zipf_cdf[k] /= sum;
+    }
+
+    /* By Little's law, about one block in two requests is allocated, so
+       target / mean_size live blocks need this mean lifetime */
+    for (mean_size = 0, i = 0; i < 10000; i++)
+	mean_size += draw_size();
+    mean_size /= 10000;
+    mean_life = 2 * (target / mean_size) * (1 + realloc_pct / 100);
+
+    sizes = calloc(num_ops, sizeof(int));
+    live = malloc(num_ops * sizeof(int));
+    pos = malloc(num_ops * sizeof(int));
+    heap = malloc(num_ops * sizeof(death_t));
+    order = malloc(num_ops * sizeof(int));
+    if ((rep = rep_new()) == NULL || sizes == NULL || live == NULL ||
+	pos == NULL || heap == NULL || order == NULL) {
+	fprintf(stderr, "tracegen: out of memory\n");
+	exit(1);
+    }
+
+    /* Leave room to free whatever is still live at the end */
+    while (rep->num_ops + num_live < num_ops) {
+	long t = rep->num_ops;
+	int id, do_free;
+
+	/* One request left over: an alloc would need a free as well */
+	if (rep->num_ops + num_live == num_ops - 1 && num_live == 0) {
+	    rep_append(rep, REP_FREE, -1, 0);
+	    continue;
+	}
+	if (num_live > 0 && (rnd() * 100 < realloc_pct ||
+			     rep->num_ops + num_live == num_ops - 1)) {
+	    double grown;
+
+	    id = live[(long)(rnd() * num_live)];
+	    grown = sizes[id] * growth;
+	    grown = grown < 1 ? 1 : grown > max_size ? max_size : grown;
+	    live_bytes += (int)grown - sizes[id];
+	    sizes[id] = (int)grown;
+	    rep_append(rep, REP_REALLOC, id, sizes[id]);
+	    continue;
+	}
+
+	if (model == EXP || model == PHASE)
+	    do_free = heap_len > 0 && heap[0].death <= t;
+	else
+	    do_free = num_live > 0 && rnd() < 0.5 * live_bytes / target;
+
+	if (do_free) {
+	    id = pick_victim();
+	    rep_append(rep, REP_FREE, id, 0);
+	    continue;
+	}
+
+	id = next_id++;
+	sizes[id] = draw_size();
+	pos[id] = num_live;
+	live[num_live++] = id;
+	live_bytes += sizes[id];
+	rep_append(rep, REP_ALLOC, id, sizes[id]);
+	if (model == EXP || (model == PHASE && rnd() < survive))
+	    heap_push(t + 1 + (long)(-log(1 - rnd()) * mean_life /
+				     (model == PHASE ? survive : 1)), id);
+	else if (model == PHASE)
+	    heap_push((t / phase_len + 1) * phase_len, id);
+	else
+	    order[tail++] = id;
+    }
+    while (num_live > 0)
+	rep_append(rep, REP_FREE, pick_victim(), 0);
+
+    rep->weight = weight;
+    rep_fixup(rep);
+    if ((binary ? rep_write_bin : rep_write)(argv[optind], rep) < 0) {
+	fprintf(stderr, "tracegen: cannot write %s\n", argv[optind]);
+	exit(1);
+    }
+    printf("%s: %d requests, %d ids, peak %d live bytes\n", argv[optind],
+	   rep->num_ops, rep->num_ids, rep->sugg_heapsize);
+    rep_free(rep);
+    return 0;
+}
+
+/*
+ * parse_dist - parse a size distribution; returns -1 if it is bad
+ */
+static int parse_dist(const char *spec)
+{
+    static const struct {
+	const char *name;
+	dist_t dist;
+	int nargs;
+    } dists[] = {
+	{"uniform", UNIFORM, 2}, {"lognormal", LOGNORMAL, 2},
+	{"zipf", ZIPF, 2}, {"bimodal", BIMODAL, 3},
+    };
+    const char *colon = strchr(spec, ':');
+    size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+    unsigned i;
+
+    for (i = 0; i < sizeof(dists) / sizeof(dists[0]); i++) {
+	if (strlen(dists[i].name) != len || strncmp(spec, dists[i].name, len))
+	    continue;
+	dist = dists[i].dist;
+	if (colon == NULL)
+	    return -1;
+	if (sscanf(colon + 1, "%lf:%lf:%lf", &dist_arg[0], &dist_arg[1],
+		   &dist_arg[2]) != dists[i].nargs)
+	    return -1;
+	if (dist == UNIFORM && (dist_arg[0] < 1 || dist_arg[1] < dist_arg[0]))
+	    return -1;
+	return 0;
+    }
+    return -1;
+}
+
+/*
+ * parse_model - parse a lifetime model; returns -1 if it is bad
+ */
+static int parse_model(const char *spec)
+{
+    if (strcmp(spec, "exp") == 0)
+	model = EXP;
+    else if (strcmp(spec, "lifo") == 0)
+	model = LIFO;
+    else if (strcmp(spec, "fifo") == 0)
+	model = FIFO;
+    else if (strncmp(spec, "phase", 5) == 0 && (spec[5] == '\0' || spec[5] == ':')) {
+	model = PHASE;
+	if (spec[5] == ':')
+	    sscanf(spec + 6, "%ld:%lf", &phase_len, &survive);
+	if (phase_len < 1 || survive <= 0 || survive > 1)
+	    return -1;
+    } else
+	return -1;
+    return 0;
+}
+
+/*
+ * rnd - uniform double in [0, 1) from a splitmix64 generator
+ */
+static double rnd(void)
+{
+    uint64_t z = (rng += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * draw_size - draw a block size from the distribution
+ */
+static int draw_size(void)
+{
+    double size = 1;
+
+    switch (dist) {
+    case UNIFORM:
+	size = dist_arg[0] + (long)(rnd() * (dist_arg[1] - dist_arg[0] + 1));
+	break;
+    case LOGNORMAL:
+	/* Box-Muller */
+	size = exp(dist_arg[0] + dist_arg[1] * sqrt(-2 * log(1 - rnd())) *
+		   cos(2 * M_PI * rnd()));
+	break;
+    case ZIPF: {
+	long lo = 0, hi = zipf_n - 1;
+	double u = rnd();
+
+	while (lo < hi) {
+	    long mid = (lo + hi) / 2;
+
+	    if (zipf_cdf[mid] < u)
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+	size = 8 * (lo + 1);
+	break;
+    }
+    case BIMODAL:
+	/* Each mode spreads an eighth of its size either way */
+	size = (rnd() < dist_arg[2]) ? dist_arg[0] : dist_arg[1];
+	size *= 0.875 + 0.25 * rnd();
+	break;
+    }
+    return size < 1 ? 1 : size > max_size ? (int)max_size : (int)size;
+}
+
+static void heap_push(long death, int id)
+{
+    int i = heap_len++;
+
+    while (i > 0 && heap[(i - 1) / 2].death > death) {
+	heap[i] = heap[(i - 1) / 2];
+	i = (i - 1) / 2;
+    }
+    heap[i].death = death;
+    heap[i].id = id;
+}
+
+static int heap_pop(void)
+{
+    int id = heap[0].id;
+    death_t last = heap[--heap_len];
+    int i = 0, child;
+
+    while ((child = 2 * i + 1) < heap_len) {
+	if (child + 1 < heap_len && heap[child + 1].death < heap[child].death)
+	    child++;
+	if (last.death <= heap[child].death)
+	    break;
+	heap[i] = heap[child];
+	i = child;
+    }
+    heap[i] = last;
+    return id;
+}
+
+/*
+ * pick_victim - remove the next block to free under the lifetime model
+ *    from the live set and return its id
+ */
+static int pick_victim(void)
+{
+    int id;
+
+    if (model == EXP || model == PHASE)
+	id = heap_pop();
+    else if (model == LIFO)
+	id = order[--tail];
+    else
+	id = order[head++];
+
+    live[pos[id]] = live[--num_live];
+    pos[live[pos[id]]] = pos[id];
+    live_bytes -= sizes[id];
+    return id;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: tracegen [-n <requests>] [-L <live bytes>] "
+	    "[-d <sizes>] [-l <lifetimes>]\n"
+	    "                [-r <pct>:<growth>] [-m <max size>] "
+	    "[-w <weight>] [-s <seed>] [-b] <out.rep>\n");
+    fprintf(stderr, "\t-d uniform:LO:HI | lognormal:MU:SIGMA | zipf:S:MAX | "
+	    "bimodal:A:B:P\n");
+    fprintf(stderr, "\t-l exp | phase:LEN[:FRAC] | lifo | fifo\n");
+}
@@ -0,0 +1,310 @@
+/*
+ * traceio.c - read, build and write .rep trace files
+ *
+ * A .rep file starts with four header lines (suggested heap size,
+ * number of ids, number of ops, weight) followed by one request per
+ * line: "a <id> <size>", "r <id> <size>" or "f <id>", where "f -1"
+ * records a free(NULL). mdriver asserts that the header agrees with
+ * the body, so writers should call rep_fixup() before rep_write().
+ * rep_read() also accepts the binary format described in traceio.h,
+ * which rep_write_bin() writes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "traceio.h"
+
+/* Capacity of the ops array, kept separately from num_ops */
+typedef struct {
+    rep_t rep;
+    int capacity;
+} rep_buf_t;
+
+/*
+ * rep_new - return an empty trace with weight 1, or NULL if out of memory
+ */
+rep_t *rep_new(void)
+{
+    rep_buf_t *buf;
+
+    if ((buf = (rep_buf_t *)calloc(1, sizeof(rep_buf_t))) == NULL)
+	return NULL;
+    buf->rep.weight = 1;
+    return &buf->rep;
+}
+
+/*
+ * rep_reserve - make room for at least capacity requests.
+ *    Returns 0 on success, -1 if out of memory.
+ */
+static int rep_reserve(rep_t *rep, int capacity)
+{
+    rep_buf_t *buf = (rep_buf_t *)rep;
+    rep_op_t *ops;
+
+    if (capacity <= buf->capacity)
+	return 0;
+    if ((ops = (rep_op_t *)realloc(rep->ops, capacity * sizeof(rep_op_t))) == NULL)
+	return -1;
+    rep->ops = ops;
+    buf->capacity = capacity;
+    return 0;
+}
+
+/*
+ * rep_append - add one request to the end of the trace.
+ *    Returns 0 on success, -1 if out of memory.
+ */
+int rep_append(rep_t *rep, rep_type_t type, int index, int size)
+{
+    rep_buf_t *buf = (rep_buf_t *)rep;
+    rep_op_t *op;
+
+    if (rep->num_ops == buf->capacity &&
+	rep_reserve(rep, buf->capacity ? 2 * buf->capacity : 1024) < 0)
+	return -1;
+    op = &rep->ops[rep->num_ops++];
+    op->type = type;
+    op->index = index;
+    op->size = (type == REP_FREE) ? 0 : size;
+    return 0;
+}
+
+/*
+ * rep_fixup - recompute num_ids and the suggested heap size (the peak
+ *    number of live payload bytes) from the requests
+ */
+void rep_fixup(rep_t *rep)
+{
+    int i, max_index = -1;
+    int *sizes;
+    long live = 0, peak = 0;
+
+    for (i = 0; i < rep->num_ops; i++)
+	if (rep->ops[i].index > max_index)
+	    max_index = rep->ops[i].index;
+    rep->num_ids = max_index + 1;
+
+    /* Without the per-id sizes we can still leave a sane header */
+    if ((sizes = (int *)calloc(rep->num_ids + 1, sizeof(int))) == NULL)
+	return;
+    for (i = 0; i < rep->num_ops; i++) {
+	rep_op_t *op = &rep->ops[i];
+
+	if (op->index < 0)
+	    continue;
+	live -= sizes[op->index];
+	sizes[op->index] = op->size;
+	live += op->size;
+	if (live > peak)
+	    peak = live;
+    }
+    free(sizes);
+    rep->sugg_heapsize = (peak > 0x7fffffff) ? 0x7fffffff : (int)peak;
+}
+
+/*
+ * rep_read_bin - read the body of a binary trace from fp, which is
+ *    positioned just past the magic
+ */
+static rep_t *rep_read_bin(const char *path, FILE *fp, rep_t *rep)
+{
+    int32_t header[4];
+    uint32_t word, size;
+    int i, n;
+
+    if (fread(header, sizeof(header), 1, fp) != 1 || header[2] < 0) {
+	fprintf(stderr, "%s: bad header\n", path);
+	goto fail;
+    }
+    rep->sugg_heapsize = header[0];
+    rep->num_ids = header[1];
+    rep->weight = header[3];
+    n = header[2];
+    if (n > 0 && rep_reserve(rep, n) < 0)
+	goto fail;
+
+    for (i = 0; i < n; i++) {
+	size = 0;
+	if (fread(&word, sizeof(word), 1, fp) != 1 || (word & 3) > REP_REALLOC ||
+	    ((word & 3) != REP_FREE && (word >> 2 == 0 ||
+	     fread(&size, sizeof(size), 1, fp) != 1 || size > 0x7fffffff))) {
+	    fprintf(stderr, "%s: bad request %d\n", path, i + 1);
+	    goto fail;
+	}
+	rep_append(rep, (rep_type_t)(word & 3), (int)(word >> 2) - 1, (int)size);
+    }
+    fclose(fp);
+    return rep;
+
+fail:
+    fclose(fp);
+    rep_free(rep);
+    return NULL;
+}
+
+/*
+ * rep_is_bin - return 1 if path holds a binary trace, 0 otherwise
+ */
+int rep_is_bin(const char *path)
+{
+    char magic[REP_BIN_MAGIC_LEN];
+    FILE *fp;
+    int bin;
+
+    if ((fp = fopen(path, "rb")) == NULL)
+	return 0;
+    bin = fread(magic, sizeof(magic), 1, fp) == 1 &&
+	memcmp(magic, REP_BIN_MAGIC, REP_BIN_MAGIC_LEN) == 0;
+    fclose(fp);
+    return bin;
+}
+
+/*
+ * rep_read - read the .rep file, text or binary, at path. Returns NULL,
+ *    with a message on stderr, if it cannot be opened or is malformed.
+ */
+rep_t *rep_read(const char *path)
+{
+    FILE *fp;
+    rep_t *rep;
+    char type[2];
+    char magic[REP_BIN_MAGIC_LEN];
+    int index, size;
+
+    if ((fp = fopen(path, "rb")) == NULL) {
+	fprintf(stderr, "%s: cannot open\n", path);
+	return NULL;
+    }
+    if ((rep = rep_new()) == NULL) {
+	fclose(fp);
+	return NULL;
+    }
+    if (fread(magic, sizeof(magic), 1, fp) == 1 &&
+	memcmp(magic, REP_BIN_MAGIC, REP_BIN_MAGIC_LEN) == 0)
+	return rep_read_bin(path, fp, rep);
+    rewind(fp);
+    if (fscanf(fp, "%d %d %d %d", &rep->sugg_heapsize, &rep->num_ids,
+	       &rep->num_ops, &rep->weight) != 4) {
+	fprintf(stderr, "%s: bad header\n", path);
+	goto fail;
+    }
+    index = rep->num_ops;
+    rep->num_ops = 0;
+    if (index > 0 && rep_reserve(rep, index) < 0)
+	goto fail;
+
+    while (fscanf(fp, "%1s", type) == 1) {
+	size = 0;
+	if (fscanf(fp, "%d", &index) != 1 || index < (type[0] == 'f' ? -1 : 0) ||
+	    (type[0] != 'f' && (fscanf(fp, "%d", &size) != 1 || size < 0))) {
+	    fprintf(stderr, "%s: bad request %d\n", path, rep->num_ops + 1);
+	    goto fail;
+	}
+	switch (type[0]) {
+	case 'a':
+	    if (rep_append(rep, REP_ALLOC, index, size) < 0)
+		goto fail;
+	    break;
+	case 'r':
+	    if (rep_append(rep, REP_REALLOC, index, size) < 0)
+		goto fail;
+	    break;
+	case 'f':
+	    if (rep_append(rep, REP_FREE, index, 0) < 0)
+		goto fail;
+	    break;
+	default:
+	    fprintf(stderr, "%s: bogus type character (%c)\n", path, type[0]);
+	    goto fail;
+	}
+    }
+    fclose(fp);
+    return rep;
+
+fail:
+    fclose(fp);
+    rep_free(rep);
+    return NULL;
+}
+
+/*
+ * rep_write - write the trace to path in .rep format.
+ *    Returns 0 on success, -1 on an I/O error.
+ */
+int rep_write(const char *path, const rep_t *rep)
+{
+    FILE *fp;
+    int i;
+
+    if ((fp = fopen(path, "w")) == NULL)
+	return -1;
+    fprintf(fp, "%d\n%d\n%d\n%d\n", rep->sugg_heapsize, rep->num_ids,
+	    rep->num_ops, rep->weight);
+    for (i = 0; i < rep->num_ops; i++) {
+	const rep_op_t *op = &rep->ops[i];
+
+	switch (op->type) {
+	case REP_ALLOC:
+	    fprintf(fp, "a %d %d\n", op->index, op->size);
+	    break;
+	case REP_REALLOC:
+	    fprintf(fp, "r %d %d\n", op->index, op->size);
+	    break;
+	case REP_FREE:
+	    fprintf(fp, "f %d\n", op->index);
+	    break;
+	}
+    }
+    if (ferror(fp)) {
+	fclose(fp);
+	return -1;
+    }
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+/*
+ * rep_write_bin - write the trace to path in the binary format.
+ *    Returns 0 on success, -1 on an I/O error.
+ */
+int rep_write_bin(const char *path, const rep_t *rep)
+{
+    FILE *fp;
+    int32_t header[4];
+    uint32_t words[2];
+    int i;
+
+    if ((fp = fopen(path, "wb")) == NULL)
+	return -1;
+    header[0] = rep->sugg_heapsize;
+    header[1] = rep->num_ids;
+    header[2] = rep->num_ops;
+    header[3] = rep->weight;
+    fwrite(REP_BIN_MAGIC, REP_BIN_MAGIC_LEN, 1, fp);
+    fwrite(header, sizeof(header), 1, fp);
+    for (i = 0; i < rep->num_ops; i++) {
+	const rep_op_t *op = &rep->ops[i];
+
+	words[0] = (uint32_t)(op->index + 1) << 2 | op->type;
+	words[1] = (uint32_t)op->size;
+	fwrite(words, sizeof(uint32_t), op->type == REP_FREE ? 1 : 2, fp);
+    }
+    if (ferror(fp)) {
+	fclose(fp);
+	return -1;
+    }
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+/*
+ * rep_free - free the trace and its ops array
+ */
+void rep_free(rep_t *rep)
+{
+    if (rep == NULL)
+	return;
+    free(rep->ops);
+    free((rep_buf_t *)rep);
+}
@@ -0,0 +1,48 @@
+/*
+ * traceio.h - in-memory representation of .rep trace files, shared by
+ *             the recorder and the trace tools
+ */
+#ifndef __TRACEIO_H_
+#define __TRACEIO_H_
+
+/* One allocator request, as in a line of a .rep file */
+typedef enum {
+    REP_ALLOC,
+    REP_FREE,
+    REP_REALLOC
+} rep_type_t;
+
+typedef struct {
+    rep_type_t type; /* type of request */
+    int index;       /* block id the request refers to */
+    int size;        /* byte size of alloc/realloc request */
+} rep_op_t;
+
+/* A whole trace: the four header fields followed by the requests */
+typedef struct {
+    int sugg_heapsize; /* suggested heap size (unused by mdriver) */
+    int num_ids;       /* number of alloc/realloc ids */
+    int num_ops;       /* number of requests */
+    int weight;        /* weight for this trace */
+    rep_op_t *ops;     /* array of num_ops requests */
+} rep_t;
+
+/*
+ * Binary traces start with this 8-byte magic, followed by the four
+ * header fields and then the requests, all as native 32-bit words.
+ * A request is one word, (id + 1) << 2 | type, followed for allocs and
+ * reallocs by a word holding the size.
+ */
+#define REP_BIN_MAGIC "MMREPBIN"
+#define REP_BIN_MAGIC_LEN 8
+
+rep_t *rep_new(void);
+rep_t *rep_read(const char *path);
+int rep_append(rep_t *rep, rep_type_t type, int index, int size);
+void rep_fixup(rep_t *rep);
+int rep_write(const char *path, const rep_t *rep);
+int rep_write_bin(const char *path, const rep_t *rep);
+int rep_is_bin(const char *path);
+void rep_free(rep_t *rep);
+
+#endif /* __TRACEIO_H_ */
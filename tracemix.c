@@ -0,0 +1,253 @@
+/*
+ * tracemix.c - scale, replicate, concatenate and downsample .rep traces
+ *
+ *   tracemix scale <factor> <in> <out>
+ *       multiply every request size by factor
+ *   tracemix replicate <k> <in> <out>
+ *       k copies of the trace one after another, each with its own ids
+ *   tracemix interleave <k> <in> <out>
+ *       k copies of the trace running side by side, one request from
+ *       each copy in turn, each with its own ids
+ *   tracemix concat <out> <in>...
+ *       the traces one after another as phases of one workload; blocks
+ *       a phase leaves allocated stay live through the later ones
+ *   tracemix sample <fraction> <in> <out>
+ *       keep every request of a random fraction of the ids
+ *
+ * Sampling by id keeps the size distribution and the order of events
+ * for every kept block, so lifetimes keep their shape relative to the
+ * length of the trace. The output header is recomputed with
+ * rep_fixup(); the weight is the first input's. -b writes the binary
+ * format, and -s seeds the sampling.
+ *
+ * usage: tracemix [-b] [-s <seed>] <command> <args>...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "traceio.h"
+
+/* function prototypes */
+static rep_t *load(const char *path);
+static void add(rep_t *out, const rep_op_t *op, int offset);
+static rep_t *new_rep(int weight);
+static rep_t *scale(rep_t *in, double factor);
+static rep_t *replicate(rep_t *in, int k, int interleave);
+static rep_t *concat(char **paths, int n);
+static rep_t *sample(rep_t *in, double fraction, unsigned long seed);
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    unsigned long seed = 1;
+    int binary = 0;
+    const char *cmd, *out;
+    rep_t *rep;
+    int c, nargs;
+
+    while ((c = getopt(argc, argv, "bs:h")) != -1) {
+	switch (c) {
+	case 'b':
+	    binary = 1;
+	    break;
+	case 's':
+	    seed = strtoul(optarg, NULL, 0);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    nargs = argc - optind;
+    if (nargs < 3) {
+	usage();
+	exit(1);
+    }
+    cmd = argv[optind];
+
+    if (strcmp(cmd, "concat") == 0) {
+	out = argv[optind + 1];
+	rep = concat(&argv[optind + 2], nargs - 2);
+    } else if (nargs == 4) {
+	const char *arg = argv[optind + 1];
+	rep_t *in = load(argv[optind + 2]);
+
+	out = argv[optind + 3];
+	if (strcmp(cmd, "scale") == 0 && atof(arg) > 0)
+	    rep = scale(in, atof(arg));
+	else if (strcmp(cmd, "replicate") == 0 && atoi(arg) > 0)
+	    rep = replicate(in, atoi(arg), 0);
+	else if (strcmp(cmd, "interleave") == 0 && atoi(arg) > 0)
+	    rep = replicate(in, atoi(arg), 1);
+	else if (strcmp(cmd, "sample") == 0 && atof(arg) > 0 && atof(arg) <= 1)
+	    rep = sample(in, atof(arg), seed);
+	else {
+	    usage();
+	    exit(1);
+	}
+	rep_free(in);
+    } else {
+	usage();
+	exit(1);
+    }
+
+    rep_fixup(rep);
+    if ((binary ? rep_write_bin : rep_write)(out, rep) < 0) {
+	fprintf(stderr, "tracemix: cannot write %s\n", out);
+	exit(1);
+    }
+    printf("%s: %d requests, %d ids, peak %d live bytes\n", out,
+	   rep->num_ops, rep->num_ids, rep->sugg_heapsize);
+    rep_free(rep);
+    return 0;
+}
+
+/*
+ * load - read a trace or exit
+ */
+static rep_t *load(const char *path)
+{
+    rep_t *rep;
+
+    if ((rep = rep_read(path)) == NULL)
+	exit(1);
+    return rep;
+}
+
+/*
+ * add - append op to out with its id moved up by offset
+ */
+static void add(rep_t *out, const rep_op_t *op, int offset)
+{
+    int index = (op->index < 0) ? -1 : op->index + offset;
+
+    if (rep_append(out, op->type, index, op->size) < 0) {
+	fprintf(stderr, "tracemix: out of memory\n");
+	exit(1);
+    }
+}
+
+static rep_t *new_rep(int weight)
+{
+    rep_t *rep;
+
+    if ((rep = rep_new()) == NULL) {
+	fprintf(stderr, "tracemix: out of memory\n");
+	exit(1);
+    }
+    rep->weight = weight;
+    return rep;
+}
+
+static rep_t *scale(rep_t *in, double factor)
+{
+    rep_t *out = new_rep(in->weight);
+    int i;
+
+    for (i = 0; i < in->num_ops; i++) {
+	rep_op_t op = in->ops[i];
+	double size = op.size * factor;
+
+	/* Zero-byte requests stay zero-byte */
+	if (op.size > 0)
+	    op.size = size < 1 ? 1 : size > INT_MAX ? INT_MAX : (int)(size + 0.5);
+	add(out, &op, 0);
+    }
+    return out;
+}
+
+static rep_t *replicate(rep_t *in, int k, int interleave)
+{
+    rep_t *out = new_rep(in->weight);
+    int i, j;
+
+    if ((long)in->num_ids * k > INT_MAX) {
+	fprintf(stderr, "tracemix: too many ids\n");
+	exit(1);
+    }
+    if (interleave) {
+	for (i = 0; i < in->num_ops; i++)
+	    for (j = 0; j < k; j++)
+		add(out, &in->ops[i], j * in->num_ids);
+    } else {
+	for (j = 0; j < k; j++)
+	    for (i = 0; i < in->num_ops; i++)
+		add(out, &in->ops[i], j * in->num_ids);
+    }
+    return out;
+}
+
+static rep_t *concat(char **paths, int n)
+{
+    rep_t *out = NULL;
+    long offset = 0;
+    int i, j;
+
+    for (j = 0; j < n; j++) {
+	rep_t *in = load(paths[j]);
+
+	if (out == NULL)
+	    out = new_rep(in->weight);
+	if (offset + in->num_ids > INT_MAX) {
+	    fprintf(stderr, "tracemix: too many ids\n");
+	    exit(1);
+	}
+	for (i = 0; i < in->num_ops; i++)
+	    add(out, &in->ops[i], (int)offset);
+	offset += in->num_ids;
+	rep_free(in);
+    }
+    return out;
+}
+
+static rep_t *sample(rep_t *in, double fraction, unsigned long seed)
+{
+    rep_t *out = new_rep(in->weight);
+    int *newid = (int *)malloc((in->num_ids + 1) * sizeof(int));
+    uint64_t threshold = (uint64_t)(fraction * 4294967296.0);
+    int i, next = 0;
+
+    if (newid == NULL) {
+	fprintf(stderr, "tracemix: out of memory\n");
+	exit(1);
+    }
+
+    /* Kept ids, including -1 for free(NULL), are numbered in order of
+       first appearance so that the output's ids are dense */
+    for (i = 0; i <= in->num_ids; i++) {
+	uint64_t h = (uint64_t)i * 0x9e3779b97f4a7c15ULL ^ seed;
+
+	h = (h ^ (h >> 31)) * 0xbf58476d1ce4e5b9ULL;
+	newid[i] = ((h >> 32) < threshold) ? -2 : -3;
+    }
+    for (i = 0; i < in->num_ops; i++) {
+	rep_op_t op = in->ops[i];
+	int *slot = &newid[op.index + 1];
+
+	if (*slot == -3)
+	    continue;
+	if (*slot == -2)
+	    *slot = (op.index < 0) ? -1 : next++;
+	op.index = *slot;
+	add(out, &op, 0);
+    }
+    free(newid);
+    return out;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: tracemix [-b] [-s <seed>] <command> <args>...\n"
+	    "\tscale <factor> <in> <out>\n"
+	    "\treplicate <k> <in> <out>\n"
+	    "\tinterleave <k> <in> <out>\n"
+	    "\tconcat <out> <in>...\n"
+	    "\tsample <fraction> <in> <out>\n");
+}
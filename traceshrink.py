@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+#
+# traceshrink.py - shrink a trace that makes mdriver fail or slow down
+#
+# Delta debugging (ddmin) over the block ids of a trace: a candidate
+# keeps every request of a subset of the ids, so each alloc stays with
+# its reallocs and its free, and the ids are renumbered densely. A
+# candidate is kept when it is still "interesting":
+#
+#   -e          mdriver reports the same first error, addresses aside,
+#               or dies of the same signal, as on the whole trace
+#   -k KOPS     mdriver's throughput on it stays below KOPS
+#   -c CMD      the shell command CMD, with {} replaced by the trace
+#               path, exits with status 0
+#
+# Candidates are tried -j at a time in parallel, and the result, which
+# no single chunk of ids can be removed from at the final granularity,
+# is written to -o (default <trace>.min.rep).
+#
+# usage: traceshrink.py (-e | -k KOPS | -c CMD) [-j jobs] [-o out]
+#                       [-m "mdriver args"] [-r runs] trace
+#
+
+import argparse
+import concurrent.futures
+import itertools
+import os
+import re
+import shlex
+import shutil
+import struct
+import subprocess
+import sys
+
+WORKDIR = "traceshrink.d"
+BIN_MAGIC = b"MMREPBIN"
+
+reError = re.compile(r"^ERROR \[[^]]*\]: (.*)$", re.M)
+reAddr = re.compile(r"0x[0-9a-fA-F]+")
+reRow = re.compile(r"^\s*0\s+yes\s+\d+%\s+\d+\s+[\d.]+\s+(\d+)", re.M)
+
+
+def readTrace(path):
+    """Return (weight, ops) where ops are (type, id, size) tuples"""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data.startswith(BIN_MAGIC):
+        words = struct.unpack_from("=4i", data, len(BIN_MAGIC))
+        weight, nops = words[3], words[2]
+        pos = len(BIN_MAGIC) + 16
+        ops = []
+        for _ in range(nops):
+            (w,) = struct.unpack_from("=I", data, pos)
+            pos += 4
+            kind = "afr"[w & 3]
+            size = 0
+            if kind != "f":
+                (size,) = struct.unpack_from("=I", data, pos)
+                pos += 4
+            ops.append((kind, (w >> 2) - 1, size))
+        return weight, ops
+    fields = data.decode().split("\n")
+    weight = int(fields[3])
+    ops = []
+    for line in fields[4:]:
+        parts = line.split()
+        if not parts:
+            continue
+        size = int(parts[2]) if parts[0] != "f" else 0
+        ops.append((parts[0], int(parts[1]), size))
+    return weight, ops
+
+
+def writeTrace(path, weight, ops, keep, drop=frozenset()):
+    """Write the requests of the ids in keep, except those at the
+    positions in drop, renumbered, as a .rep"""
+    newid = {-1: -1}
+    out = []
+    live = {}
+    cur = peak = 0
+    for pos, (kind, i, size) in enumerate(ops):
+        if i not in keep or pos in drop:
+            continue
+        if i not in newid:
+            newid[i] = len(newid) - 1
+        out.append("%s %d %d" % (kind, newid[i], size) if kind != "f"
+                   else "f %d" % newid[i])
+        if i >= 0:
+            cur += size - live.get(i, 0)
+            live[i] = size
+            peak = max(peak, cur)
+    with open(path, "w") as f:
+        f.write("%d\n%d\n%d\n%d\n" % (peak, len(newid) - 1, len(out), weight))
+        f.write("\n".join(out) + "\n")
+
+
+def ddmin(units, test, pool, jobs, what):
+    """Shrink units to a subset that test() still accepts and from which
+    no chunk at the final granularity can be removed"""
+    n = 2
+    while len(units) >= 2:
+        size = len(units) / n
+        chunks = [units[int(k * size):int((k + 1) * size)] for k in range(n)]
+        cands = list(chunks)
+        if n > 2:
+            cands += [units[:int(k * size)] + units[int((k + 1) * size):]
+                      for k in range(n)]
+        found = None
+        for start in range(0, len(cands), jobs):
+            batch = cands[start:start + jobs]
+            for k, ok in enumerate(pool.map(test, batch)):
+                if ok:
+                    found = start + k
+                    break
+            if found is not None:
+                break
+        if found is not None and found < n:
+            units, n = cands[found], 2
+        elif found is not None:
+            units, n = cands[found], max(n - 1, 2)
+        elif n >= len(units):
+            break
+        else:
+            n = min(2 * n, len(units))
+        print("%d %s, granularity %d" % (len(units), what, n))
+    return units
+
+
+class Predicate:
+    def __init__(self, args):
+        self.args = args
+        self.error = None
+
+    def run(self, path):
+        cmd = [self.args.d, "-f", path] + shlex.split(self.args.m)
+        try:
+            proc = subprocess.run(cmd, capture_output=True, text=True,
+                                  timeout=self.args.t)
+        except subprocess.TimeoutExpired:
+            return None
+        return proc
+
+    def signature(self, path):
+        """The first error mdriver reports on path, or None"""
+        proc = self.run(path)
+        if proc is None:
+            return None
+        if proc.returncode < 0:
+            return "signal %d" % -proc.returncode
+        m = reError.search(proc.stdout)
+        # Addresses differ from run to run
+        return reAddr.sub("0x?", m.group(1)) if m else None
+
+    def kops(self, path):
+        best = 0
+        for _ in range(self.args.r):
+            proc = self.run(path)
+            m = reRow.search(proc.stdout) if proc else None
+            if m is None:
+                return None
+            best = max(best, int(m.group(1)))
+        return best
+
+    def __call__(self, path):
+        if self.args.c:
+            cmd = self.args.c.replace("{}", shlex.quote(path))
+            return subprocess.run(cmd, shell=True,
+                                  capture_output=True).returncode == 0
+        if self.args.e:
+            return self.signature(path) == self.error
+        kops = self.kops(path)
+        return kops is not None and kops < self.args.k
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Shrink a failing trace")
+    mode = parser.add_mutually_exclusive_group(required=True)
+    mode.add_argument("-e", action="store_true",
+                      help="keep candidates with the same mdriver error")
+    mode.add_argument("-k", type=float, help="keep candidates below KOPS")
+    mode.add_argument("-c", help="keep candidates for which CMD {} exits 0")
+    parser.add_argument("-j", type=int, default=os.cpu_count(),
+                        help="parallel jobs (default: number of cores)")
+    parser.add_argument("-o", help="output trace (default: <trace>.min.rep)")
+    parser.add_argument("-m", default="-v",
+                        help="mdriver arguments (default: -v)")
+    parser.add_argument("-d", default="./mdriver", help="mdriver to run")
+    parser.add_argument("-r", type=int, default=3,
+                        help="runs per candidate with -k, best counts")
+    parser.add_argument("-t", type=int, default=300,
+                        help="timeout per run in seconds")
+    parser.add_argument("trace")
+    args = parser.parse_args()
+
+    weight, ops = readTrace(args.trace)
+    units = sorted({i for _, i, _ in ops}, key=lambda i: (i < 0, i))
+    pred = Predicate(args)
+    os.makedirs(WORKDIR, exist_ok=True)
+
+    # mdriver reads -f paths relative to the current directory
+    def path(n):
+        return os.path.join(WORKDIR, "cand%d.rep" % n)
+
+    whole = path(0)
+    writeTrace(whole, weight, ops, set(units))
+    if args.e:
+        pred.error = pred.signature(whole)
+        if pred.error is None:
+            sys.exit("%s: mdriver reports no error" % args.trace)
+        print("error: %s" % pred.error)
+    elif not pred(whole):
+        sys.exit("%s: the trace itself is not interesting" % args.trace)
+
+    counter = itertools.count(1)
+    tried = [0]
+
+    def attempt(keep, drop=frozenset()):
+        p = path(next(counter))
+        writeTrace(p, weight, ops, keep, drop)
+        ok = pred(p)
+        os.remove(p)
+        tried[0] += 1
+        return ok
+
+    with concurrent.futures.ThreadPoolExecutor(args.j) as pool:
+        # First whole ids, then the reallocs of the ids that are left;
+        # dropping a realloc keeps the id's alloc and free paired
+        units = ddmin(units, lambda u: attempt(set(u)), pool, args.j, "ids")
+        keep = set(units)
+        seen = set()
+        reallocs = []
+        for pos, (kind, i, _) in enumerate(ops):
+            if kind == "r" and i in seen:
+                reallocs.append(pos)
+            seen.add(i)
+        reallocs = [pos for pos in reallocs if ops[pos][1] in keep]
+        if reallocs and attempt(keep, set(reallocs)):
+            kept = []
+        else:
+            kept = ddmin(reallocs,
+                         lambda r: attempt(keep, set(reallocs) - set(r)),
+                         pool, args.j, "reallocs")
+        drop = set(reallocs) - set(kept)
+
+    out = args.o or re.sub(r"(\.rep)?$", ".min.rep", args.trace, count=1)
+    writeTrace(out, weight, ops, keep, drop)
+    print("wrote %s: %d ids, %d candidates tried" % (out, len(units),
+                                                       tried[0]))
+    shutil.rmtree(WORKDIR, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
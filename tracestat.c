@@ -0,0 +1,315 @@
+/*
+ * tracestat.c - describe the shape of .rep traces
+ *
+ * For each trace, prints
+ *
+ *   - the request mix and the peak live set (bytes and blocks),
+ *   - the live-bytes and live-blocks curves, sampled at -p points,
+ *   - a histogram of alloc and realloc sizes in power-of-two buckets,
+ *   - a histogram of lifetimes in requests, from alloc to free,
+ *   - a histogram of realloc growth ratios (new size / old size),
+ *   - the working set: distinct ids touched per window of -w requests,
+ *   - the share of frees that free the newest live block (LIFO) or
+ *     the oldest one (FIFO).
+ *
+ * A realloc keeps its id's birth and its place in allocation order.
+ *
+ * usage: tracestat [-p <points>] [-w <window>] <trace.rep>...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "traceio.h"
+
+#define NBUCKETS 32   /* power-of-two buckets: [2^i, 2^(i+1)) */
+
+/* Realloc growth ratio buckets, by upper bound */
+static const double growth_bounds[] = {0.5, 1, 1.0001, 1.5, 2, 4, 1e300};
+static const char *growth_names[] = {
+    "< 0.5", "0.5 - 1", "1", "1 - 1.5", "1.5 - 2", "2 - 4", ">= 4"
+};
+#define NGROWTH (sizeof(growth_bounds) / sizeof(growth_bounds[0]))
+
+/* function prototypes */
+static int analyze(const char *path, int points, long window);
+static int bucket(long n);
+static int live_birth(const rep_t *rep, const char *alive, const long *born,
+		      long at);
+static void print_hist(const char *title, const char *unit, long *count,
+		       double *bytes);
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    int points = 10;
+    long window = 1000;
+    int c, status = 0;
+
+    while ((c = getopt(argc, argv, "p:w:h")) != -1) {
+	switch (c) {
+	case 'p':
+	    points = atoi(optarg);
+	    break;
+	case 'w':
+	    window = strtol(optarg, NULL, 0);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (optind == argc || points < 1 || window < 1) {
+	usage();
+	exit(1);
+    }
+    for (; optind < argc; optind++)
+	if (analyze(argv[optind], points, window) < 0)
+	    status = 1;
+    return status;
+}
+
+/*
+ * analyze - print the statistics of the trace at path.
+ *    Returns 0 on success, -1 on error.
+ */
+static int analyze(const char *path, int points, long window)
+{
+    rep_t *rep;
+    long *born, *size, *seen;   /* per id */
+    long *order;                /* births of live ids, in allocation order */
+    char *alive;
+    long head = 0, tail = 0;
+    long nalloc = 0, nfree = 0, nrealloc = 0, nnull = 0;
+    long nlifo = 0, nfifo = 0, never = 0;
+    long live_blocks = 0, peak_blocks = 0, peak_at = 0;
+    double live_bytes = 0, peak_bytes = 0;
+    long size_count[NBUCKETS], life_count[NBUCKETS], growth[NGROWTH];
+    double size_bytes[NBUCKETS];
+    long nwindows = 0, distinct = 0, max_distinct = 0;
+    double sum_distinct = 0;
+    int i, next_point = 0;
+
+    if ((rep = rep_read(path)) == NULL)
+	return -1;
+    born = (long *)malloc(rep->num_ids * sizeof(long));
+    size = (long *)calloc(rep->num_ids, sizeof(long));
+    seen = (long *)malloc(rep->num_ids * sizeof(long));
+    order = (long *)malloc((rep->num_ops + 1) * sizeof(long));
+    alive = (char *)calloc(rep->num_ids, 1);
+    if (born == NULL || size == NULL || seen == NULL || order == NULL ||
+	alive == NULL) {
+	fprintf(stderr, "%s: out of memory\n", path);
+	exit(1);
+    }
+    memset(size_count, 0, sizeof(size_count));
+    memset(size_bytes, 0, sizeof(size_bytes));
+    memset(life_count, 0, sizeof(life_count));
+    memset(growth, 0, sizeof(growth));
+    for (i = 0; i < rep->num_ids; i++)
+	seen[i] = -1;
+
+    printf("%s\n", path);
+    printf("  live set curve:\n  %12s %12s %14s\n", "request", "blocks",
+	   "bytes");
+    for (i = 0; i < rep->num_ops; i++) {
+	rep_op_t *op = &rep->ops[i];
+	long id = op->index;
+
+	if (id >= rep->num_ids) {
+	    fprintf(stderr, "%s: id %ld out of range\n", path, id);
+	    goto fail;
+	}
+
+	/* Working set: distinct ids in each window of requests */
+	if (i % window == 0 && i > 0) {
+	    sum_distinct += distinct;
+	    if (distinct > max_distinct)
+		max_distinct = distinct;
+	    nwindows++;
+	    distinct = 0;
+	}
+	if (id >= 0 && seen[id] < i / window) {
+	    seen[id] = i / window;
+	    distinct++;
+	}
+
+	switch (op->type) {
+	case REP_ALLOC:
+	case REP_REALLOC:
+	    if (op->type == REP_REALLOC && alive[id]) {
+		unsigned g = 0;
+
+		while (size[id] > 0 && g < NGROWTH - 1 &&
+		       (double)op->size / size[id] >= growth_bounds[g])
+		    g++;
+		growth[size[id] > 0 ? g : NGROWTH - 1]++;
+		nrealloc++;
+		live_bytes -= size[id];
+	    } else {
+		/* alloc, or realloc(NULL, size) */
+		if (op->type == REP_ALLOC)
+		    nalloc++;
+		else
+		    nrealloc++;
+		born[id] = i;
+		alive[id] = 1;
+		order[tail++] = i;
+		live_blocks++;
+	    }
+	    size[id] = op->size;
+	    live_bytes += op->size;
+	    size_count[bucket(op->size)]++;
+	    size_bytes[bucket(op->size)] += op->size;
+	    break;
+
+	case REP_FREE:
+	    if (id < 0 || !alive[id]) {
+		nnull++;
+		break;
+	    }
+	    nfree++;
+	    life_count[bucket(i - born[id])]++;
+
+	    /* Dead entries at either end of the order are dropped lazily.
+	       An entry is the request that gave birth to a block, so it
+	       is dead once its id is freed or born again. */
+	    while (!live_birth(rep, alive, born, order[head]))
+		head++;
+	    while (!live_birth(rep, alive, born, order[tail - 1]))
+		tail--;
+	    if (order[tail - 1] == born[id])
+		nlifo++;
+	    if (order[head] == born[id])
+		nfifo++;
+	    alive[id] = 0;
+	    live_blocks--;
+	    live_bytes -= size[id];
+	    break;
+	}
+
+	if (live_bytes > peak_bytes) {
+	    peak_bytes = live_bytes;
+	    peak_at = i;
+	}
+	if (live_blocks > peak_blocks)
+	    peak_blocks = live_blocks;
+	if (i == (long)rep->num_ops * next_point / points ||
+	    i == rep->num_ops - 1) {
+	    printf("  %12d %12ld %14.0f\n", i, live_blocks, live_bytes);
+	    next_point++;
+	}
+    }
+    if (distinct > 0) {
+	sum_distinct += distinct;
+	if (distinct > max_distinct)
+	    max_distinct = distinct;
+	nwindows++;
+    }
+    for (i = 0; i < rep->num_ids; i++)
+	if (alive[i])
+	    never++;
+
+    printf("  requests: %d (%ld alloc, %ld realloc, %ld free, %ld free of "
+	   "no block), %d ids\n", rep->num_ops, nalloc, nrealloc, nfree, nnull,
+	   rep->num_ids);
+    printf("  peak live set: %.0f bytes at request %ld, %ld blocks\n",
+	   peak_bytes, peak_at, peak_blocks);
+    print_hist("request sizes (share of requests and of bytes)", "bytes",
+	       size_count, size_bytes);
+    print_hist("lifetimes", "requests", life_count, NULL);
+    printf("    never freed: %ld\n", never);
+    printf("  realloc growth ratios:\n");
+    for (i = 0; i < (int)NGROWTH; i++)
+	if (growth[i] > 0)
+	    printf("    %-10s %10ld\n", growth_names[i], growth[i]);
+    printf("  working set: %.1f ids per %ld requests on average, %ld at most\n",
+	   nwindows ? sum_distinct / nwindows : 0, window, max_distinct);
+    printf("  frees of the newest live block (LIFO): %.1f%%, "
+	   "of the oldest (FIFO): %.1f%%\n\n",
+	   nfree ? 100.0 * nlifo / nfree : 0, nfree ? 100.0 * nfifo / nfree : 0);
+
+    free(born);
+    free(size);
+    free(seen);
+    free(order);
+    free(alive);
+    rep_free(rep);
+    return 0;
+
+fail:
+    free(born);
+    free(size);
+    free(seen);
+    free(order);
+    free(alive);
+    rep_free(rep);
+    return -1;
+}
+
+/*
+ * live_birth - is the block born by request at still live?
+ */
+static int live_birth(const rep_t *rep, const char *alive, const long *born,
+		      long at)
+{
+    long id = rep->ops[at].index;
+
+    return alive[id] && born[id] == at;
+}
+
+/*
+ * bucket - index of the power-of-two bucket that holds n
+ */
+static int bucket(long n)
+{
+    int b = 0;
+
+    while (n > 1 && b < NBUCKETS - 1) {
+	n >>= 1;
+	b++;
+    }
+    return b;
+}
+
+/*
+ * print_hist - print the non-empty buckets of a histogram, with the
+ *    share of the total count and, if given, of the total bytes
+ */
+static void print_hist(const char *title, const char *unit, long *count,
+		       double *bytes)
+{
+    double total = 0, total_bytes = 0;
+    int i;
+
+    for (i = 0; i < NBUCKETS; i++) {
+	total += count[i];
+	if (bytes != NULL)
+	    total_bytes += bytes[i];
+    }
+    printf("  %s:\n  %24s %10s %7s%s\n", title, unit, "count", "share",
+	   bytes ? "   bytes" : "");
+    for (i = 0; i < NBUCKETS; i++) {
+	if (count[i] == 0)
+	    continue;
+	printf("  %11ld - %10ld %10ld %6.1f%%", i ? 1L << i : 0L,
+	       (1L << (i + 1)) - 1, count[i], 100 * count[i] / total);
+	if (bytes != NULL)
+	    printf(" %6.1f%%", total_bytes ? 100 * bytes[i] / total_bytes : 0);
+	printf("\n");
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: tracestat [-p <points>] [-w <window>] "
+	    "<trace.rep>...\n");
+    fprintf(stderr, "\t-p <n>     Sample the live set curve at <n> points "
+	    "(default 10).\n");
+    fprintf(stderr, "\t-w <n>     Working set window in requests "
+	    "(default 1000).\n");
+}